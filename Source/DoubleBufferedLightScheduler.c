@@ -0,0 +1,68 @@
+/*!
+ * @file
+ * @brief Double-buffered light scheduler implementation.
+ */
+
+#include <stddef.h>
+#include "DoubleBufferedLightScheduler.h"
+
+void DoubleBufferedLightScheduler_Init(
+   DoubleBufferedLightScheduler_t *instance,
+   LightScheduler_t *first,
+   LightScheduler_t *second)
+{
+   instance->active = first;
+   instance->pending = NULL;
+   instance->staging = second;
+}
+
+// The acquire pairs with the run's release of the plan it replaced, so the run is done with it
+LightScheduler_t *DoubleBufferedLightScheduler_BeginPlan(DoubleBufferedLightScheduler_t *instance)
+{
+   LightScheduler_t *plan = __atomic_exchange_n(&instance->staging, NULL, __ATOMIC_ACQUIRE);
+
+   if(plan == NULL)
+   {
+      return NULL;
+   }
+
+   for(uint32_t lightId = 0; lightId < LIGHTSCHEDULER_LIGHT_COUNT; lightId++)
+   {
+      LightScheduler_RemoveAllForLight(plan, (LightSchedulerLightId_t)lightId);
+   }
+   LightScheduler_UseScheduleImage(plan, NULL, 0);
+
+   return plan;
+}
+
+// The release publishes every change made while building the plan to the run that adopts it
+void DoubleBufferedLightScheduler_Publish(DoubleBufferedLightScheduler_t *instance, LightScheduler_t *plan)
+{
+   __atomic_store_n(&instance->pending, plan, __ATOMIC_RELEASE);
+}
+
+bool DoubleBufferedLightScheduler_PlanAdopted(DoubleBufferedLightScheduler_t *instance)
+{
+   return __atomic_load_n(&instance->staging, __ATOMIC_ACQUIRE) != NULL;
+}
+
+void DoubleBufferedLightScheduler_Run(DoubleBufferedLightScheduler_t *instance)
+{
+   LightScheduler_t *plan = __atomic_exchange_n(&instance->pending, NULL, __ATOMIC_ACQUIRE);
+
+   if(plan != NULL)
+   {
+      LightScheduler_t *replaced = instance->active;
+
+      LightScheduler_TakeOverFrom(plan, replaced);
+      instance->active = plan;
+      __atomic_store_n(&instance->staging, replaced, __ATOMIC_RELEASE);
+   }
+
+   LightScheduler_Run(instance->active);
+}
+
+LightScheduler_t *DoubleBufferedLightScheduler_Active(DoubleBufferedLightScheduler_t *instance)
+{
+   return instance->active;
+}
@@ -0,0 +1,78 @@
+/*!
+ * @file
+ * @brief Light scheduler whose whole plan of schedules is replaced at once.  A new plan is built in a
+ * second light scheduler, possibly on another thread, while the current plan keeps running, and is
+ * then published with a single atomic pointer store.  The next run switches to it, so a run always
+ * sees one whole plan and never waits for the thread building the next one.
+ */
+
+#ifndef DOUBLEBUFFEREDLIGHTSCHEDULER_H
+#define DOUBLEBUFFEREDLIGHTSCHEDULER_H
+
+#include <stdbool.h>
+#include "LightScheduler.h"
+
+/*!
+ * active is only used by the thread that runs the plans.  A plan moves from staging to the thread
+ * building it, to pending when it is published, and to active when a run adopts it, and the plan it
+ * replaces goes back to staging.  staging and pending are exchanged atomically between the threads.
+ */
+typedef struct
+{
+   LightScheduler_t *active;
+   LightScheduler_t *pending;
+   LightScheduler_t *staging;
+} DoubleBufferedLightScheduler_t;
+
+/*!
+ * Initialize a double-buffered light scheduler.  Both light schedulers must be initialized with the
+ * same lights and time source, and may keep their schedules in different kinds of index.
+ * @param instance The double-buffered light scheduler.
+ * @param first The light scheduler that runs first, with any schedules it already has.
+ * @param second The light scheduler the first new plan is built in.
+ */
+void DoubleBufferedLightScheduler_Init(
+   DoubleBufferedLightScheduler_t *instance,
+   LightScheduler_t *first,
+   LightScheduler_t *second);
+
+/*!
+ * Start building a new plan.  Only call from the thread that builds plans.
+ * @param instance The double-buffered light scheduler.
+ * @return A light scheduler with no schedules and no schedule image to build the plan in, or NULL if
+ *    the last plan published has not been adopted by a run yet.
+ */
+LightScheduler_t *DoubleBufferedLightScheduler_BeginPlan(DoubleBufferedLightScheduler_t *instance);
+
+/*!
+ * Publish a plan, so that the next run adopts it.  The plan must not be changed after it is published.
+ * Only call from the thread that builds plans.
+ * @param instance The double-buffered light scheduler.
+ * @param plan The light scheduler returned by DoubleBufferedLightScheduler_BeginPlan.
+ */
+void DoubleBufferedLightScheduler_Publish(DoubleBufferedLightScheduler_t *instance, LightScheduler_t *plan);
+
+/*!
+ * Check whether the last plan published has been adopted, so that another can be built.  Only call
+ * from the thread that builds plans.
+ * @param instance The double-buffered light scheduler.
+ * @return True if DoubleBufferedLightScheduler_BeginPlan would return a plan.
+ */
+bool DoubleBufferedLightScheduler_PlanAdopted(DoubleBufferedLightScheduler_t *instance);
+
+/*!
+ * Run the active plan, as LightScheduler_Run, after adopting a newly published plan if there is one.
+ * The new plan takes over from the old one as LightScheduler_TakeOverFrom describes, so the run
+ * catches up on the new plan's schedules due since the last run.
+ * @param instance The double-buffered light scheduler.
+ */
+void DoubleBufferedLightScheduler_Run(DoubleBufferedLightScheduler_t *instance);
+
+/*!
+ * @param instance The double-buffered light scheduler.
+ * @return The plan that is running, for other calls from the thread that runs it.  It changes when a
+ *    run adopts a new plan.
+ */
+LightScheduler_t *DoubleBufferedLightScheduler_Active(DoubleBufferedLightScheduler_t *instance);
+
+#endif
@@ -6,12 +6,22 @@
 #ifndef I_DIGITALOUTPUTGROUP_H
 #define I_DIGITALOUTPUTGROUP_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "uassert.h"
 
 typedef uint16_t DigitalOutputChannel_t;
 
+/*!
+ * One channel write in a group of writes.
+ */
+typedef struct
+{
+   DigitalOutputChannel_t channel;
+   bool state;
+} DigitalOutputWrite_t;
+
 struct I_DigitalOutputGroup_Api_t;
 
 /*!
@@ -31,6 +41,12 @@ typedef struct
 typedef struct I_DigitalOutputGroup_Api_t
 {
    void (*Write)(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state);
+
+   /*!
+    * Optional.  Write several channels in one operation, for groups where each operation is costly
+    * (e.g. a bus transaction).  NULL if the group only writes one channel at a time.
+    */
+   void (*WriteMany)(I_DigitalOutputGroup_t *instance, const DigitalOutputWrite_t *writes, const uint16_t count);
 } I_DigitalOutputGroup_Api_t;
 
 /*!
@@ -43,4 +59,23 @@ typedef struct I_DigitalOutputGroup_Api_t
 #define DigitalOutputGroup_Write(instance, channel, state) \
    (instance)->api->Write((instance), (channel), (state))
 
+/*!
+ * Write to several digital output channels in one operation.
+ * @pre instance != NULL
+ * @pre DigitalOutputGroup_SupportsWriteMany(instance)
+ * @param instance The digital output group.
+ * @param writes The channels and the states to write to them.
+ * @param count The number of writes.
+ */
+#define DigitalOutputGroup_WriteMany(instance, writes, count) \
+   (instance)->api->WriteMany((instance), (writes), (count))
+
+/*!
+ * Check whether a digital output group can write several channels in one operation.
+ * @pre instance != NULL
+ * @param instance The digital output group.
+ */
+#define DigitalOutputGroup_SupportsWriteMany(instance) \
+   ((instance)->api->WriteMany != NULL)
+
 #endif
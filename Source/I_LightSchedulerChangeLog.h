@@ -0,0 +1,46 @@
+/*!
+ * @file
+ * @brief Append-only log of the changes made to a light scheduler's schedules, so that they can be
+ * persisted as they happen instead of snapshotting every schedule after each change.  Replaying the
+ * changes logged since a snapshot with LightScheduler_ApplyCommand, on a light scheduler restored
+ * from that snapshot, gives back the same schedules.  The log is compacted by taking a new snapshot
+ * and starting a new log from it.
+ */
+
+#ifndef I_LIGHTSCHEDULERCHANGELOG_H
+#define I_LIGHTSCHEDULERCHANGELOG_H
+
+#include "LightSchedulerCommand.h"
+
+struct I_LightSchedulerChangeLog_Api_t;
+
+/*!
+ * Generic light scheduler change log.
+ */
+typedef struct I_LightSchedulerChangeLog_t
+{
+   /*!
+    * API for interacting with a particular kind of change log, e.g. one that writes to a file.
+    */
+   const struct I_LightSchedulerChangeLog_Api_t *api;
+} I_LightSchedulerChangeLog_t;
+
+/*!
+ * Interface for interacting with a change log.  API should be accessed using wrapper calls below.
+ */
+typedef struct I_LightSchedulerChangeLog_Api_t
+{
+   void (*Append)(I_LightSchedulerChangeLog_t *instance, const LightSchedulerCommand_t *change);
+} I_LightSchedulerChangeLog_Api_t;
+
+/*!
+ * Add a change to the end of a change log.  Called by the light scheduler from the thread that makes
+ * the change, so a log that writes somewhere slow should hand the change on instead of waiting.
+ * @pre instance != NULL
+ * @param instance The change log.
+ * @param change The change.  Only valid during the call.
+ */
+#define LightSchedulerChangeLog_Append(instance, change) \
+   (instance)->api->Append((instance), (change))
+
+#endif
@@ -0,0 +1,92 @@
+/*!
+ * @file
+ * @brief Index of schedule slots by due time.  Lets the light scheduler find the schedules that are
+ * due without visiting every slot, with a choice of how the index is kept.
+ */
+
+#ifndef I_SCHEDULEINDEX_H
+#define I_SCHEDULEINDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ScheduleTicks.h"
+
+/*!
+ * Position of a schedule in the light scheduler's schedule table.
+ */
+typedef uint32_t ScheduleSlot_t;
+
+struct I_ScheduleIndex_Api_t;
+
+/*!
+ * Generic schedule index.
+ */
+typedef struct
+{
+   /*!
+    * API for interacting with a particular kind of schedule index.
+    */
+   const struct I_ScheduleIndex_Api_t *api;
+} I_ScheduleIndex_t;
+
+/*!
+ * Interface for interacting with a schedule index.  API should be accessed using wrapper calls below.
+ */
+typedef struct I_ScheduleIndex_Api_t
+{
+   void (*Insert)(I_ScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot);
+   bool (*Remove)(I_ScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot);
+   uint32_t (*CollectDue)(I_ScheduleIndex_t *instance, ScheduleTicks_t first, ScheduleTicks_t last, ScheduleSlot_t *slots);
+   bool (*NextDue)(I_ScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time);
+} I_ScheduleIndex_Api_t;
+
+/*!
+ * Add a slot to a schedule index.
+ * @pre instance != NULL
+ * @pre The slot is not in the index and the index has room for it.
+ * @param instance The schedule index.
+ * @param time The time the slot is due.
+ * @param slot The slot.
+ */
+#define ScheduleIndex_Insert(instance, time, slot) \
+   (instance)->api->Insert((instance), (time), (slot))
+
+/*!
+ * Remove a slot from a schedule index.
+ * @pre instance != NULL
+ * @param instance The schedule index.
+ * @param time The time the slot was inserted with.
+ * @param slot The slot.
+ * @return True if the slot was found and removed.
+ */
+#define ScheduleIndex_Remove(instance, time, slot) \
+   (instance)->api->Remove((instance), (time), (slot))
+
+/*!
+ * Copy out the slots due from first through last, in order of time and, for slots due at the same
+ * time, in the order they were inserted.
+ * @pre instance != NULL
+ * @pre first <= last
+ * @pre slots has room for every slot in the index.
+ * @param instance The schedule index.
+ * @param first The first time to collect.
+ * @param last The last time to collect.
+ * @param slots Set to the due slots.
+ * @return The number of due slots.
+ */
+#define ScheduleIndex_CollectDue(instance, first, last, slots) \
+   (instance)->api->CollectDue((instance), (first), (last), (slots))
+
+/*!
+ * Find the first time at or after a time that a slot is due, wrapping around to the earliest time
+ * in the index if no slot is due between from and the last time.
+ * @pre instance != NULL
+ * @param instance The schedule index.
+ * @param from The time to search from.
+ * @param time Set to the time the next slot is due.
+ * @return False if the index is empty.
+ */
+#define ScheduleIndex_NextDue(instance, from, time) \
+   (instance)->api->NextDue((instance), (from), (time))
+
+#endif
@@ -3,53 +3,1334 @@
  * @brief Light scheduler implementation.
  */
 
+#include <stddef.h>
+#include <string.h>
 #include "LightScheduler.h"
+#include "LightSchedulerCommandQueue.h"
+#include "I_LightSchedulerChangeLog.h"
+#include "uassert.h"
 
-// static uint8_t schedule_counter = 0;
+static void *TakeStorage(LightSchedulerStorage_t **storage, uint32_t count, size_t size)
+{
+    void *array = *storage;
+    *storage += (count * size + sizeof(**storage) - 1) / sizeof(**storage);
+    return array;
+}
+
+// light IDs only need checking when there are fewer lights than the IDs can name
+static bool LightIdIsValid(LightSchedulerLightId_t lightId)
+{
+#if LIGHTSCHEDULER_LIGHT_COUNT < (1UL << LIGHTSCHEDULER_LIGHT_ID_BITS)
+    return lightId < LIGHTSCHEDULER_LIGHT_COUNT;
+#else
+    (void)lightId;
+    return true;
+#endif
+}
+
+// statistics cost nothing unless they are compiled in
+#ifdef LIGHTSCHEDULER_STATS
+#define COUNT_STAT(instance, counter, amount) ((instance)->stats.counter += (amount))
+#else
+#define COUNT_STAT(instance, counter, amount)
+#endif
+
+static bool SlotIsActive(const LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    return (instance->activeSlots[slot / 32] >> (slot % 32)) & 1;
+}
+
+static void SetSlotActive(LightScheduler_t *instance, ScheduleSlot_t slot, bool active)
+{
+    if(active) {
+        instance->activeSlots[slot / 32] |= (uint32_t)1 << (slot % 32);
+    }
+    else {
+        instance->activeSlots[slot / 32] &= ~((uint32_t)1 << (slot % 32));
+    }
+}
 
 void LightScheduler_Init(LightScheduler_t *instance, I_DigitalOutputGroup_t *lights, I_TimeSource_t *timeSource)
+{
+    LightScheduler_InitWithStorage(instance, lights, timeSource, instance->defaultStorage, MAX_SCHEDULES);
+}
+
+// carves out the storage every light scheduler needs and returns what is left for the index
+static LightSchedulerStorage_t *InitSlots(
+    LightScheduler_t *instance,
+    I_DigitalOutputGroup_t *lights,
+    I_TimeSource_t *timeSource,
+    LightSchedulerStorage_t *storage,
+    uint32_t maxSchedules)
 {
     instance->lights = lights;
     instance->timeSource = timeSource;
+    instance->commandQueue = NULL;
+    instance->changeLog = NULL;
+    instance->maxSchedules = maxSchedules;
+    instance->pendingWriteCount = 0;
+    instance->hasRun = false;
+    instance->lastRunTicks = 0;
+    instance->shadowEnabled = false;
+    instance->image = NULL;
+    instance->imageCount = 0;
+    instance->imageCursor = 0;
+    LightScheduler_ResetStats(instance);
+
+    uint32_t activeSlotWords = LIGHTSCHEDULER_ACTIVE_SLOT_WORDS(maxSchedules);
+    instance->activeSlots = TakeStorage(&storage, activeSlotWords, sizeof(uint32_t));
+    instance->nextSlots = TakeStorage(&storage, maxSchedules, sizeof(ScheduleSlot_t));
+    instance->previousSlots = TakeStorage(&storage, maxSchedules, sizeof(ScheduleSlot_t));
+    instance->generations = TakeStorage(&storage, maxSchedules, sizeof(uint16_t));
+    instance->schedules = TakeStorage(&storage, maxSchedules, sizeof(Schedule_t));
+    instance->periods = TakeStorage(&storage, maxSchedules, sizeof(ScheduleTicks_t));
+    instance->remainingRuns = TakeStorage(&storage, maxSchedules, sizeof(uint32_t));
+    instance->dueSlots = TakeStorage(&storage, maxSchedules, sizeof(ScheduleSlot_t));
+
+    for(uint32_t i = 0; i < activeSlotWords; i++) {
+        instance->activeSlots[i] = 0;
+    }
+
+    for(uint32_t i = 0; i < LIGHTSCHEDULER_LIGHT_COUNT; i++) {
+        instance->lightHeads[i] = LIGHTSCHEDULER_NO_SLOT;
+    }
+
+    for(uint32_t i = 0; i < maxSchedules; i++) {
+        instance->generations[i] = 1;
+        instance->nextSlots[i] = i + 1;
+    }
+
+    if(maxSchedules > 0) {
+        instance->nextSlots[maxSchedules - 1] = LIGHTSCHEDULER_NO_SLOT;
+    }
+    instance->freeSlot = (maxSchedules > 0) ? 0 : LIGHTSCHEDULER_NO_SLOT;
+    instance->scheduleCount = 0;
+
+    return storage;
 }
 
-void LightScheduler_AddSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time)
+void LightScheduler_InitWithStorage(
+    LightScheduler_t *instance,
+    I_DigitalOutputGroup_t *lights,
+    I_TimeSource_t *timeSource,
+    LightSchedulerStorage_t *storage,
+    uint32_t maxSchedules)
 {
-    uint8_t schedulesSize = sizeof(instance->schedules)/ sizeof(instance->schedules[0]);
-    for(uint8_t i = 0; i < schedulesSize; i++) {
-        if(instance->schedules[i].active == false) {
-            instance->schedules[i].active = true;
-            instance->schedules[i].lightId = lightId;
-            instance->schedules[i].lightState = lightState;
-            instance->schedules[i].time = time;
-            break;
+    storage = InitSlots(instance, lights, timeSource, storage, maxSchedules);
+
+    uint32_t indexCapacity = LIGHTSCHEDULER_INDEX_CAPACITY(maxSchedules);
+    ScheduleSlot_t *indexSlots = TakeStorage(&storage, indexCapacity, sizeof(ScheduleSlot_t));
+    ScheduleTicks_t *indexTimes = TakeStorage(&storage, indexCapacity, sizeof(ScheduleTicks_t));
+
+    SortedScheduleIndex_Init(&instance->indexes.sorted, indexTimes, indexSlots, indexCapacity);
+    instance->index = &instance->indexes.sorted.interface;
+    instance->indexIsSorted = true;
+}
+
+void LightScheduler_InitWithTimingWheel(
+    LightScheduler_t *instance,
+    I_DigitalOutputGroup_t *lights,
+    I_TimeSource_t *timeSource,
+    LightSchedulerStorage_t *storage,
+    uint32_t maxSchedules,
+    uint32_t buckets)
+{
+    storage = InitSlots(instance, lights, timeSource, storage, maxSchedules);
+
+    ScheduleTicks_t *times = TakeStorage(&storage, maxSchedules, sizeof(ScheduleTicks_t));
+    ScheduleSlot_t *next = TakeStorage(&storage, maxSchedules, sizeof(ScheduleSlot_t));
+    ScheduleSlot_t *previous = TakeStorage(&storage, maxSchedules, sizeof(ScheduleSlot_t));
+    ScheduleSlot_t *heads = TakeStorage(&storage, buckets, sizeof(ScheduleSlot_t));
+    uint32_t *occupied = TakeStorage(&storage, TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(buckets), sizeof(uint32_t));
+
+    TimingWheelScheduleIndex_Init(&instance->indexes.timingWheel, times, next, previous, heads, occupied, maxSchedules, buckets);
+    instance->index = &instance->indexes.timingWheel.interface;
+    instance->indexIsSorted = false;
+}
+
+static void LinkToLight(LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    ScheduleSlot_t *head = &instance->lightHeads[instance->schedules[slot].lightId];
+
+    instance->nextSlots[slot] = *head;
+    instance->previousSlots[slot] = LIGHTSCHEDULER_NO_SLOT;
+    if(*head != LIGHTSCHEDULER_NO_SLOT) {
+        instance->previousSlots[*head] = slot;
+    }
+    *head = slot;
+}
+
+static void UnlinkFromLight(LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    ScheduleSlot_t next = instance->nextSlots[slot];
+    ScheduleSlot_t previous = instance->previousSlots[slot];
+
+    if(previous == LIGHTSCHEDULER_NO_SLOT) {
+        instance->lightHeads[instance->schedules[slot].lightId] = next;
+    }
+    else {
+        instance->nextSlots[previous] = next;
+    }
+
+    if(next != LIGHTSCHEDULER_NO_SLOT) {
+        instance->previousSlots[next] = previous;
+    }
+}
+
+// handles to the slot's previous schedules stop matching once the slot is freed
+static void FreeSlot(LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    UnlinkFromLight(instance, slot);
+    SetSlotActive(instance, slot, false);
+    instance->nextSlots[slot] = instance->freeSlot;
+    instance->freeSlot = slot;
+    instance->scheduleCount--;
+
+    instance->generations[slot]++;
+    if(instance->generations[slot] == 0) {
+        instance->generations[slot] = 1;
+    }
+}
+
+static bool HandleIsCurrent(const LightScheduler_t *instance, LightSchedulerHandle_t handle)
+{
+    return handle.slot < instance->maxSchedules &&
+        SlotIsActive(instance, handle.slot) &&
+        instance->generations[handle.slot] == handle.generation;
+}
+
+static void LogChange(
+    LightScheduler_t *instance,
+    LightSchedulerCommandType_t type,
+    LightSchedulerLightId_t lightId,
+    bool lightState,
+    ScheduleTicks_t time,
+    ScheduleTicks_t period,
+    uint32_t count)
+{
+    if(instance->changeLog != NULL) {
+        LightSchedulerCommand_t change = { (uint8_t)type, lightState, lightId, time, period, count };
+        LightSchedulerChangeLog_Append(instance->changeLog, &change);
+    }
+}
+
+// a one-time schedule's remaining runs are never set, so they are logged as 0
+static void LogSlotRemoved(LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    const Schedule_t *schedule = &instance->schedules[slot];
+    ScheduleTicks_t period = instance->periods[slot];
+
+    LogChange(
+        instance,
+        LightSchedulerCommandType_RemoveOne,
+        schedule->lightId,
+        schedule->lightState,
+        schedule->time,
+        period,
+        (period > 0) ? instance->remainingRuns[slot] : 0);
+}
+
+static void RemoveSlot(LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    ScheduleIndex_Remove(instance->index, instance->schedules[slot].time, slot);
+    FreeSlot(instance, slot);
+}
+
+// the slot is filled in but left for the caller to add to the index
+static ScheduleSlot_t FillFreeSlot(
+    LightScheduler_t *instance,
+    LightSchedulerLightId_t lightId,
+    bool lightState,
+    ScheduleTicks_t time,
+    ScheduleTicks_t period,
+    uint32_t count)
+{
+    ScheduleSlot_t slot = instance->freeSlot;
+
+    instance->freeSlot = instance->nextSlots[slot];
+    instance->scheduleCount++;
+    SetSlotActive(instance, slot, true);
+    instance->schedules[slot].lightId = lightId;
+    instance->schedules[slot].lightState = lightState;
+    instance->schedules[slot].time = time;
+    instance->periods[slot] = period;
+    instance->remainingRuns[slot] = count;
+    LinkToLight(instance, slot);
+
+    return slot;
+}
+
+static LightSchedulerStatus_t AddToSlot(
+    LightScheduler_t *instance,
+    LightSchedulerLightId_t lightId,
+    bool lightState,
+    ScheduleTicks_t time,
+    ScheduleTicks_t period,
+    uint32_t count,
+    LightSchedulerHandle_t *handle)
+{
+    uassert(LightIdIsValid(lightId));
+
+    if(instance->freeSlot == LIGHTSCHEDULER_NO_SLOT) {
+        COUNT_STAT(instance, insertFailures, 1);
+        return LightSchedulerStatus_Full;
+    }
+
+    ScheduleSlot_t slot = FillFreeSlot(instance, lightId, lightState, time, period, count);
+    ScheduleIndex_Insert(instance->index, time, slot);
+
+    if(handle != NULL) {
+        handle->slot = slot;
+        handle->generation = instance->generations[slot];
+    }
+
+    return LightSchedulerStatus_Ok;
+}
+
+LightSchedulerStatus_t LightScheduler_TryAddSchedule(
+    LightScheduler_t *instance,
+    LightSchedulerLightId_t lightId,
+    bool lightState,
+    ScheduleTicks_t time,
+    LightSchedulerHandle_t *handle)
+{
+    LightSchedulerStatus_t status = AddToSlot(instance, lightId, lightState, time, 0, 0, handle);
+
+    if(status == LightSchedulerStatus_Ok) {
+        LogChange(instance, LightSchedulerCommandType_Add, lightId, lightState, time, 0, 0);
+    }
+
+    return status;
+}
+
+LightSchedulerHandle_t LightScheduler_AddSchedule(LightScheduler_t *instance, LightSchedulerLightId_t lightId, bool lightState, ScheduleTicks_t time)
+{
+    LightSchedulerHandle_t handle = { 0, 0 };
+    LightScheduler_TryAddSchedule(instance, lightId, lightState, time, &handle);
+    return handle;
+}
+
+// schedules due at the same tick load in table order, so every position in the table sorts apart
+static bool LoadsBefore(const Schedule_t *schedules, ScheduleSlot_t a, ScheduleSlot_t b)
+{
+    return schedules[a].time < schedules[b].time || (schedules[a].time == schedules[b].time && a < b);
+}
+
+static void SiftDown(const Schedule_t *schedules, ScheduleSlot_t *order, uint32_t root, uint32_t count)
+{
+    while(true) {
+        uint32_t largest = root;
+        uint32_t left = 2 * root + 1;
+        uint32_t right = left + 1;
+
+        if(left < count && LoadsBefore(schedules, order[largest], order[left])) {
+            largest = left;
         }
+        if(right < count && LoadsBefore(schedules, order[largest], order[right])) {
+            largest = right;
+        }
+        if(largest == root) {
+            return;
+        }
+
+        ScheduleSlot_t swap = order[root];
+        order[root] = order[largest];
+        order[largest] = swap;
+        root = largest;
     }
 }
 
-// this doesn't remove it, it just marks it inactive
-void LightScheduler_RemoveSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time)
+// heapsort needs no storage beyond the order being sorted
+static void SortLoadOrder(const Schedule_t *schedules, ScheduleSlot_t *order, uint32_t count)
+{
+    for(uint32_t root = count / 2; root > 0; root--) {
+        SiftDown(schedules, order, root - 1, count);
+    }
+
+    for(uint32_t end = count; end > 1; end--) {
+        ScheduleSlot_t swap = order[0];
+        order[0] = order[end - 1];
+        order[end - 1] = swap;
+        SiftDown(schedules, order, 0, end - 1);
+    }
+}
+
+static ScheduleTicks_t TimeOfSlot(const void *context, ScheduleSlot_t slot)
+{
+    return ((const LightScheduler_t *)context)->schedules[slot].time;
+}
+
+// dueSlots is only used during a run, so it holds the order a table is loaded in
+static ScheduleSlot_t *FindLoadOrder(LightScheduler_t *instance, const Schedule_t *schedules, uint32_t count)
 {
-    uint8_t schedulesSize = sizeof(instance->schedules)/ sizeof(instance->schedules[0]);
-    for(uint8_t i = 0; i < schedulesSize; i++) {
-        if(instance->schedules[i].active == true &&
-           instance->schedules[i].lightId == lightId &&
-           instance->schedules[i].lightState == lightState &&
-           instance->schedules[i].time == time)
-           {
-               instance->schedules[i].active = false;
-           }
+    ScheduleSlot_t *order = instance->dueSlots;
+    bool inOrder = true;
+
+    for(uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+        if(i > 0 && schedules[i].time < schedules[i - 1].time) {
+            inOrder = false;
+        }
+    }
+
+    // a timing wheel adds slots in constant time in any order, and slots due at the same tick stay
+    // in table order either way, so only the sorted index is worth sorting for
+    if(!inOrder && instance->indexIsSorted) {
+        SortLoadOrder(schedules, order, count);
     }
+
+    return order;
 }
 
+LightSchedulerStatus_t LightScheduler_LoadSchedules(LightScheduler_t *instance, const Schedule_t *schedules, uint32_t count)
+{
+    if(count > instance->maxSchedules - instance->scheduleCount) {
+        COUNT_STAT(instance, insertFailures, count);
+        return LightSchedulerStatus_Full;
+    }
+
+    for(uint32_t i = 0; i < count; i++) {
+        uassert(LightIdIsValid(schedules[i].lightId));
+    }
+
+    ScheduleSlot_t *order = FindLoadOrder(instance, schedules, count);
+
+    if(!instance->indexIsSorted) {
+        for(uint32_t i = 0; i < count; i++) {
+            const Schedule_t *schedule = &schedules[order[i]];
+            LightScheduler_TryAddSchedule(instance, schedule->lightId, schedule->lightState, schedule->time, NULL);
+        }
+        return LightSchedulerStatus_Ok;
+    }
+
+    // each table position is replaced by the slot its schedule went into, which is then merged into
+    // the index with the rest in one pass
+    for(uint32_t i = 0; i < count; i++) {
+        const Schedule_t *schedule = &schedules[order[i]];
+        order[i] = FillFreeSlot(instance, schedule->lightId, schedule->lightState, schedule->time, 0, 0);
+        LogChange(instance, LightSchedulerCommandType_Add, schedule->lightId, schedule->lightState, schedule->time, 0, 0);
+    }
+    SortedScheduleIndex_InsertMany(&instance->indexes.sorted, order, count, TimeOfSlot, instance);
+
+    return LightSchedulerStatus_Ok;
+}
+
+LightSchedulerHandle_t LightScheduler_AddRecurringSchedule(
+    LightScheduler_t *instance,
+    LightSchedulerLightId_t lightId,
+    bool lightState,
+    ScheduleTicks_t firstTime,
+    ScheduleTicks_t period,
+    uint32_t count)
+{
+    uassert(period > 0);
+
+    LightSchedulerHandle_t handle = { 0, 0 };
+
+    if(AddToSlot(instance, lightId, lightState, firstTime, period, count, &handle) == LightSchedulerStatus_Ok) {
+        LogChange(instance, LightSchedulerCommandType_AddRecurring, lightId, lightState, firstTime, period, count);
+    }
+
+    return handle;
+}
+
+ScheduleTicks_t LightScheduler_CurrentTicks(const LightScheduler_t *instance)
+{
+    return instance->lastRunTicks;
+}
+
+enum {
+    ImageCursorWalkLimit = 8
+};
+
+void LightScheduler_UseScheduleImage(LightScheduler_t *instance, const Schedule_t *image, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++) {
+        uassert(LightIdIsValid(image[i].lightId));
+        uassert(i == 0 || image[i - 1].time <= image[i].time);
+    }
+
+    instance->image = image;
+    instance->imageCount = count;
+    instance->imageCursor = 0;
+}
+
+static uint32_t ImageLowerBoundBetween(const LightScheduler_t *instance, uint32_t low, uint32_t high, ScheduleTicks_t time)
+{
+    while(low < high) {
+        uint32_t middle = low + (high - low) / 2;
+
+        if(instance->image[middle].time < time) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+// runs look for the ticks after the previous run, so the cursor usually only has a few entries to
+// step over before the search would pay off
+static uint32_t ImageLowerBound(LightScheduler_t *instance, ScheduleTicks_t time)
+{
+    uint32_t position = instance->imageCursor;
+
+    if(position > 0 && instance->image[position - 1].time >= time) {
+        position = ImageLowerBoundBetween(instance, 0, instance->imageCount, time);
+    }
+    else {
+        uint8_t steps = 0;
+
+        while(position < instance->imageCount && instance->image[position].time < time) {
+            if(++steps > ImageCursorWalkLimit) {
+                position = ImageLowerBoundBetween(instance, position, instance->imageCount, time);
+                break;
+            }
+            position++;
+        }
+    }
+
+    instance->imageCursor = position;
+    return position;
+}
+
+bool LightScheduler_NextDueTick(LightScheduler_t *instance, ScheduleTicks_t *tick)
+{
+    ScheduleTicks_t from = instance->hasRun ? (ScheduleTicks_t)(instance->lastRunTicks + 1) : instance->lastRunTicks;
+    bool found = ScheduleIndex_NextDue(instance->index, from, tick);
+
+    if(instance->imageCount > 0) {
+        uint32_t position = ImageLowerBound(instance, from);
+        ScheduleTicks_t imageTick = instance->image[(position < instance->imageCount) ? position : 0].time;
+
+        if(!found || (ScheduleTicks_t)(imageTick - from) < (ScheduleTicks_t)(*tick - from)) {
+            *tick = imageTick;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool LightScheduler_TicksUntilDue(LightScheduler_t *instance, ScheduleTicks_t *ticks)
+{
+    ScheduleTicks_t tick;
+
+    if(!LightScheduler_NextDueTick(instance, &tick)) {
+        return false;
+    }
+
+    // a schedule at the last run's tick is next due a whole wrap later, which does not fit
+    *ticks = tick - instance->lastRunTicks;
+    if(*ticks == 0) {
+        *ticks = SCHEDULETICKS_MAX;
+    }
+    return true;
+}
+
+uint32_t LightScheduler_ScheduleCount(const LightScheduler_t *instance)
+{
+    return instance->scheduleCount;
+}
+
+bool LightScheduler_ScheduleExists(const LightScheduler_t *instance, LightSchedulerHandle_t handle)
+{
+    return HandleIsCurrent(instance, handle);
+}
+
+bool LightScheduler_RemoveScheduleByHandle(LightScheduler_t *instance, LightSchedulerHandle_t handle)
+{
+    if(!HandleIsCurrent(instance, handle)) {
+        return false;
+    }
+
+    LogSlotRemoved(instance, handle.slot);
+    RemoveSlot(instance, handle.slot);
+    return true;
+}
+
+void LightScheduler_RemoveSchedule(LightScheduler_t *instance, LightSchedulerLightId_t lightId, bool lightState, ScheduleTicks_t time)
+{
+    uint32_t dueCount = ScheduleIndex_CollectDue(instance->index, time, time, instance->dueSlots);
+    bool removed = false;
+
+    for(uint32_t i = 0; i < dueCount; i++) {
+        ScheduleSlot_t slot = instance->dueSlots[i];
+
+        if(instance->schedules[slot].lightId == lightId && instance->schedules[slot].lightState == lightState) {
+            RemoveSlot(instance, slot);
+            removed = true;
+        }
+    }
+
+    if(removed) {
+        LogChange(instance, LightSchedulerCommandType_Remove, lightId, lightState, time, 0, 0);
+    }
+}
+
+static uint32_t RemoveSlotsForLight(LightScheduler_t *instance, LightSchedulerLightId_t lightId)
+{
+    uint32_t removed = 0;
+
+    while(instance->lightHeads[lightId] != LIGHTSCHEDULER_NO_SLOT) {
+        RemoveSlot(instance, instance->lightHeads[lightId]);
+        removed++;
+    }
+
+    return removed;
+}
+
+uint32_t LightScheduler_RemoveAllForLight(LightScheduler_t *instance, LightSchedulerLightId_t lightId)
+{
+    if(!LightIdIsValid(lightId)) {
+        return 0;
+    }
+
+    uint32_t removed = RemoveSlotsForLight(instance, lightId);
+
+    if(removed > 0) {
+        LogChange(instance, LightSchedulerCommandType_RemoveAllForLight, lightId, false, 0, 0, 0);
+    }
+
+    return removed;
+}
+
+// the light's own list is searched, since a recurring schedule's time alone does not identify it
+static void RemoveOneMatching(LightScheduler_t *instance, const LightSchedulerCommand_t *command)
+{
+    ScheduleSlot_t slot = instance->lightHeads[command->lightId];
+
+    for(; slot != LIGHTSCHEDULER_NO_SLOT; slot = instance->nextSlots[slot]) {
+        const Schedule_t *schedule = &instance->schedules[slot];
+        ScheduleTicks_t period = instance->periods[slot];
+
+        if(schedule->lightState == command->lightState &&
+            schedule->time == command->time &&
+            period == command->period &&
+            (period == 0 || instance->remainingRuns[slot] == command->count)) {
+            LogSlotRemoved(instance, slot);
+            RemoveSlot(instance, slot);
+            return;
+        }
+    }
+}
+
+void LightScheduler_IterateLight(
+    const LightScheduler_t *instance,
+    LightSchedulerLightId_t lightId,
+    LightSchedulerLightIterator_t *iterator)
+{
+    uassert(LightIdIsValid(lightId));
+
+    iterator->scheduler = instance;
+    iterator->slot = instance->lightHeads[lightId];
+}
+
+bool LightScheduler_NextForLight(LightSchedulerLightIterator_t *iterator, Schedule_t *schedule, LightSchedulerHandle_t *handle)
+{
+    ScheduleSlot_t slot = iterator->slot;
+
+    if(slot == LIGHTSCHEDULER_NO_SLOT) {
+        return false;
+    }
+
+    // moves on before returning so that the caller can remove this schedule
+    iterator->slot = iterator->scheduler->nextSlots[slot];
+    *schedule = iterator->scheduler->schedules[slot];
+
+    if(handle != NULL) {
+        handle->slot = slot;
+        handle->generation = iterator->scheduler->generations[slot];
+    }
+
+    return true;
+}
+
+static void FlushWrites(LightScheduler_t *instance)
+{
+    if(instance->pendingWriteCount > 0) {
+        DigitalOutputGroup_WriteMany(instance->lights, instance->pendingWrites, instance->pendingWriteCount);
+        instance->pendingWriteCount = 0;
+    }
+}
+
+static void QueueWrite(LightScheduler_t *instance, DigitalOutputChannel_t channel, bool state)
+{
+    COUNT_STAT(instance, writes, 1);
+
+    if(!DigitalOutputGroup_SupportsWriteMany(instance->lights)) {
+        DigitalOutputGroup_Write(instance->lights, channel, state);
+        return;
+    }
+
+    if(instance->pendingWriteCount == LIGHTSCHEDULER_WRITE_BATCH_SIZE) {
+        FlushWrites(instance);
+    }
+
+    instance->pendingWrites[instance->pendingWriteCount].channel = channel;
+    instance->pendingWrites[instance->pendingWriteCount].state = state;
+    instance->pendingWriteCount++;
+}
+
+static bool LightBit(const uint32_t *bits, LightSchedulerLightId_t lightId)
+{
+    return (bits[lightId / 32] >> (lightId % 32)) & 1;
+}
+
+static void SetLightBit(uint32_t *bits, LightSchedulerLightId_t lightId, bool set)
+{
+    if(set) {
+        bits[lightId / 32] |= (uint32_t)1 << (lightId % 32);
+    }
+    else {
+        bits[lightId / 32] &= ~((uint32_t)1 << (lightId % 32));
+    }
+}
+
+static void WriteLight(LightScheduler_t *instance, LightSchedulerLightId_t lightId, bool state)
+{
+    if(instance->shadowEnabled) {
+        if(LightBit(instance->shadowKnown, lightId) && LightBit(instance->shadowStates, lightId) == state) {
+            return;
+        }
+
+        SetLightBit(instance->shadowKnown, lightId, true);
+        SetLightBit(instance->shadowStates, lightId, state);
+    }
+
+    QueueWrite(instance, lightId, state);
+}
+
+void LightScheduler_EnableShadow(LightScheduler_t *instance)
+{
+    instance->shadowEnabled = true;
+
+    for(uint32_t i = 0; i < LIGHTSCHEDULER_LIGHT_WORDS; i++) {
+        instance->shadowKnown[i] = 0;
+        instance->shadowStates[i] = 0;
+    }
+}
+
+void LightScheduler_ResyncShadow(LightScheduler_t *instance)
+{
+    if(!instance->shadowEnabled) {
+        return;
+    }
+
+    for(uint32_t lightId = 0; lightId < LIGHTSCHEDULER_LIGHT_COUNT; lightId++) {
+        if(LightBit(instance->shadowKnown, (LightSchedulerLightId_t)lightId)) {
+            QueueWrite(instance, (DigitalOutputChannel_t)lightId, LightBit(instance->shadowStates, (LightSchedulerLightId_t)lightId));
+        }
+    }
+
+    FlushWrites(instance);
+}
+
+void LightScheduler_TakeOverFrom(LightScheduler_t *instance, LightScheduler_t *previous)
+{
+    instance->hasRun = previous->hasRun;
+    instance->lastRunTicks = previous->lastRunTicks;
+    instance->shadowEnabled = previous->shadowEnabled;
+
+    for(uint32_t i = 0; i < LIGHTSCHEDULER_LIGHT_WORDS; i++) {
+        instance->shadowKnown[i] = previous->shadowKnown[i];
+        instance->shadowStates[i] = previous->shadowStates[i];
+    }
+
+#ifdef LIGHTSCHEDULER_STATS
+    instance->stats = previous->stats;
+#endif
+
+    instance->commandQueue = previous->commandQueue;
+    instance->changeLog = previous->changeLog;
+    previous->commandQueue = NULL;
+    previous->changeLog = NULL;
+}
+
+// dueEnd is where the window's slots end in dueSlots; imageBegin and imageEnd bound its image entries
+typedef struct
+{
+    ScheduleTicks_t first;
+    ScheduleTicks_t last;
+    uint32_t dueEnd;
+    uint32_t imageBegin;
+    uint32_t imageEnd;
+} DueWindow_t;
+
+// the window since the last run is split in two when the schedule ticks wrapped around in between
+static uint8_t FindWindowsSinceLastRun(LightScheduler_t *instance, ScheduleTicks_t now, DueWindow_t *windows)
+{
+    if(!instance->hasRun) {
+        windows[0].first = now;
+        windows[0].last = now;
+        return 1;
+    }
+
+    if(now == instance->lastRunTicks) {
+        return 0;
+    }
+
+    ScheduleTicks_t first = instance->lastRunTicks + 1;
+
+    if(first <= now) {
+        windows[0].first = first;
+        windows[0].last = now;
+        return 1;
+    }
+
+    windows[0].first = first;
+    windows[0].last = SCHEDULETICKS_MAX;
+    windows[1].first = 0;
+    windows[1].last = now;
+    return 2;
+}
+
+// the number of occurrences of a due recurring schedule from its time up to and including now
+static ScheduleTicks_t OccurrencesDue(const LightScheduler_t *instance, ScheduleSlot_t slot, ScheduleTicks_t now)
+{
+    return (ScheduleTicks_t)(now - instance->schedules[slot].time) / instance->periods[slot] + 1;
+}
+
+// every occurrence up to now was covered by the run that just happened, so the schedule moves on to
+// its first occurrence after now; it is added again, so it also becomes the newest for its light
+static void Reschedule(LightScheduler_t *instance, ScheduleSlot_t slot, ScheduleTicks_t now)
+{
+    Schedule_t *schedule = &instance->schedules[slot];
+    ScheduleTicks_t period = instance->periods[slot];
+    ScheduleTicks_t runs = OccurrencesDue(instance, slot, now);
+
+    LogSlotRemoved(instance, slot);
+    ScheduleIndex_Remove(instance->index, schedule->time, slot);
+
+    if(instance->remainingRuns[slot] != LIGHTSCHEDULER_REPEAT_FOREVER) {
+        if(instance->remainingRuns[slot] <= runs) {
+            FreeSlot(instance, slot);
+            return;
+        }
+        instance->remainingRuns[slot] -= (uint32_t)runs;
+    }
+
+    schedule->time += runs * period;
+    ScheduleIndex_Insert(instance->index, schedule->time, slot);
+    UnlinkFromLight(instance, slot);
+    LinkToLight(instance, slot);
+    LogChange(instance, LightSchedulerCommandType_AddRecurring, schedule->lightId, schedule->lightState, schedule->time, period, instance->remainingRuns[slot]);
+}
+
+// a due entry is a position in dueSlots, or the index of an image entry with DUE_ENTRY_IMAGE set
+#define DUE_ENTRY_IMAGE ((uint32_t)1 << 31)
+
+static const Schedule_t *DueEntrySchedule(const LightScheduler_t *instance, uint32_t entry)
+{
+    if(entry & DUE_ENTRY_IMAGE) {
+        return &instance->image[entry & ~DUE_ENTRY_IMAGE];
+    }
+    return &instance->schedules[instance->dueSlots[entry]];
+}
+
+// the tick an entry last came due at, counted from the start of the run's first window; a recurring
+// schedule that came due more than once was added again each time, so it repeated
+static ScheduleTicks_t LastDue(
+    const LightScheduler_t *instance,
+    const DueWindow_t *windows,
+    uint8_t windowCount,
+    uint32_t entry,
+    bool *repeated)
+{
+    const Schedule_t *schedule = DueEntrySchedule(instance, entry);
+    ScheduleTicks_t time = schedule->time;
+
+    *repeated = false;
+
+    if(!(entry & DUE_ENTRY_IMAGE) && instance->periods[instance->dueSlots[entry]] != 0) {
+        ScheduleSlot_t slot = instance->dueSlots[entry];
+        ScheduleTicks_t runs = OccurrencesDue(instance, slot, windows[windowCount - 1].last);
+
+        if(instance->remainingRuns[slot] != LIGHTSCHEDULER_REPEAT_FOREVER && instance->remainingRuns[slot] < runs) {
+            runs = instance->remainingRuns[slot];
+        }
+
+        *repeated = runs > 1;
+        time += (runs - 1) * instance->periods[slot];
+    }
+
+    return time - windows[0].first;
+}
+
+// the one due last wins; of those due at the same tick, one that repeated wins, then schedules win
+// over image entries, then the one added last wins
+static bool DueBefore(const LightScheduler_t *instance, const DueWindow_t *windows, uint8_t windowCount, uint32_t a, uint32_t b)
+{
+    bool aRepeated;
+    bool bRepeated;
+    ScheduleTicks_t aDue = LastDue(instance, windows, windowCount, a, &aRepeated);
+    ScheduleTicks_t bDue = LastDue(instance, windows, windowCount, b, &bRepeated);
+
+    if(aDue != bDue) {
+        return aDue < bDue;
+    }
+    if(aRepeated != bRepeated) {
+        return bRepeated;
+    }
+    if((a & DUE_ENTRY_IMAGE) != (b & DUE_ENTRY_IMAGE)) {
+        return (a & DUE_ENTRY_IMAGE) != 0;
+    }
+    return a < b;
+}
+
+// latestDueForLight is left over from earlier runs for lights that are not due in this one, so an
+// entry found there is only trusted if it is due in this run for the same light
+static bool EntryIsDue(
+    const LightScheduler_t *instance,
+    const DueWindow_t *windows,
+    uint8_t windowCount,
+    uint32_t entry,
+    LightSchedulerLightId_t lightId)
+{
+    bool inRun = false;
+
+    if(entry & DUE_ENTRY_IMAGE) {
+        uint32_t image = entry & ~DUE_ENTRY_IMAGE;
+
+        for(uint8_t i = 0; i < windowCount; i++) {
+            inRun = inRun || (image >= windows[i].imageBegin && image < windows[i].imageEnd);
+        }
+    }
+    else {
+        inRun = entry < windows[windowCount - 1].dueEnd;
+    }
+
+    return inRun && DueEntrySchedule(instance, entry)->lightId == lightId;
+}
+
+static void ConsiderDue(LightScheduler_t *instance, const DueWindow_t *windows, uint8_t windowCount, uint32_t entry)
+{
+    LightSchedulerLightId_t lightId = DueEntrySchedule(instance, entry)->lightId;
+    uint32_t latest = instance->latestDueForLight[lightId];
+
+    if(!EntryIsDue(instance, windows, windowCount, latest, lightId) || DueBefore(instance, windows, windowCount, latest, entry)) {
+        instance->latestDueForLight[lightId] = entry;
+    }
+}
+
+// finds the entry that wins for each light that is due
+static void FindLatestDue(LightScheduler_t *instance, const DueWindow_t *windows, uint8_t windowCount, uint32_t dueCount)
+{
+    for(uint32_t due = 0; due < dueCount; due++) {
+        ConsiderDue(instance, windows, windowCount, due);
+    }
+
+    for(uint8_t i = 0; i < windowCount; i++) {
+        for(uint32_t image = windows[i].imageBegin; image < windows[i].imageEnd; image++) {
+            ConsiderDue(instance, windows, windowCount, image | DUE_ENTRY_IMAGE);
+        }
+    }
+}
+
+// the winners are written in the order they came due, with image entries before schedules due at the
+// same tick
+static void WriteLatestDue(LightScheduler_t *instance, const DueWindow_t *windows, uint8_t windowCount)
+{
+    uint32_t due = 0;
+
+    for(uint8_t i = 0; i < windowCount; i++) {
+        uint32_t image = windows[i].imageBegin;
+
+        while(due < windows[i].dueEnd || image < windows[i].imageEnd) {
+            uint32_t entry;
+
+            if(due == windows[i].dueEnd ||
+                (image < windows[i].imageEnd && instance->image[image].time <= instance->schedules[instance->dueSlots[due]].time)) {
+                entry = (image++) | DUE_ENTRY_IMAGE;
+            }
+            else {
+                entry = due++;
+            }
+
+            const Schedule_t *schedule = DueEntrySchedule(instance, entry);
+            if(instance->latestDueForLight[schedule->lightId] == entry) {
+                WriteLight(instance, schedule->lightId, schedule->lightState);
+            }
+        }
+    }
+}
+
+void LightScheduler_UseCommandQueue(LightScheduler_t *instance, LightSchedulerCommandQueue_t *queue)
+{
+    instance->commandQueue = queue;
+}
+
+void LightScheduler_UseChangeLog(LightScheduler_t *instance, I_LightSchedulerChangeLog_t *changeLog)
+{
+    instance->changeLog = changeLog;
+}
+
+// commands come from other threads and change logs, so a light ID they got wrong is ignored rather
+// than asserted on
+void LightScheduler_ApplyCommand(LightScheduler_t *instance, const LightSchedulerCommand_t *command)
+{
+    if(!LightIdIsValid(command->lightId)) {
+        return;
+    }
+
+    switch(command->type) {
+        case LightSchedulerCommandType_Add:
+            LightScheduler_TryAddSchedule(instance, command->lightId, command->lightState, command->time, NULL);
+            break;
+
+        case LightSchedulerCommandType_AddRecurring:
+            LightScheduler_AddRecurringSchedule(instance, command->lightId, command->lightState, command->time, command->period, command->count);
+            break;
+
+        case LightSchedulerCommandType_Remove:
+            LightScheduler_RemoveSchedule(instance, command->lightId, command->lightState, command->time);
+            break;
+
+        case LightSchedulerCommandType_RemoveAllForLight:
+            LightScheduler_RemoveAllForLight(instance, command->lightId);
+            break;
+
+        case LightSchedulerCommandType_RemoveOne:
+            RemoveOneMatching(instance, command);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void ApplyQueuedCommands(LightScheduler_t *instance)
+{
+    LightSchedulerCommandQueue_t *queue = instance->commandQueue;
+    LightSchedulerCommand_t command;
+
+    if(queue == NULL) {
+        return;
+    }
+
+    for(uint32_t applied = 0; applied <= queue->mask && LightSchedulerCommandQueue_Pop(queue, &command); applied++) {
+        LightScheduler_ApplyCommand(instance, &command);
+    }
+}
+
+#ifdef LIGHTSCHEDULER_STATS
+static void CountRunCycles(LightScheduler_t *instance, uint32_t cycles)
+{
+    LightSchedulerStats_t *stats = &instance->stats;
+
+    stats->runs++;
+    if(cycles < stats->minCycles) {
+        stats->minCycles = cycles;
+    }
+    if(cycles > stats->maxCycles) {
+        stats->maxCycles = cycles;
+    }
+    stats->cycleHistogram[31 - __builtin_clz(cycles | 1)]++;
+}
+#endif
+
 void LightScheduler_Run(LightScheduler_t *instance)
 {
-    TimeSourceTickCount_t time = TimeSource_GetTicks(instance->timeSource);
-    uint8_t schedulesSize = sizeof(instance->schedules)/ sizeof(instance->schedules[0]);
-    for(uint8_t i = 0; i < schedulesSize; i++) {
-        if ((time == instance->schedules[i].time) && (instance->schedules[i].active))
-        {
-            DigitalOutputGroup_Write(instance->lights, instance->schedules[i].lightId, instance->schedules[i].lightState);
+#ifdef LIGHTSCHEDULER_STATS
+    uint32_t startCycles = LIGHTSCHEDULER_STATS_CYCLE_COUNT();
+#endif
+
+    ApplyQueuedCommands(instance);
+
+    TimeSourceTickCount_t sourceTicks = TimeSource_GetTicks(instance->timeSource);
+
+    // the low bits of the last run's tick are the time source's ticks at the last run, so only the
+    // time source ticks that passed since then need adding
+    ScheduleTicks_t now = sourceTicks;
+    if(instance->hasRun) {
+        now = instance->lastRunTicks + (TimeSourceTickCount_t)(sourceTicks - (TimeSourceTickCount_t)instance->lastRunTicks);
+    }
+
+    DueWindow_t windows[2] = { { 0 } };
+    uint8_t windowCount = FindWindowsSinceLastRun(instance, now, windows);
+    instance->hasRun = true;
+    instance->lastRunTicks = now;
+
+    ScheduleSlot_t *dueSlots = instance->dueSlots;
+    uint32_t dueCount = 0;
+    for(uint8_t i = 0; i < windowCount; i++) {
+        dueCount += ScheduleIndex_CollectDue(instance->index, windows[i].first, windows[i].last, &dueSlots[dueCount]);
+        windows[i].dueEnd = dueCount;
+
+        windows[i].imageBegin = 0;
+        windows[i].imageEnd = 0;
+        if(instance->imageCount > 0) {
+            windows[i].imageBegin = ImageLowerBound(instance, windows[i].first);
+            windows[i].imageEnd = (windows[i].last == SCHEDULETICKS_MAX) ?
+                instance->imageCount :
+                ImageLowerBound(instance, windows[i].last + 1);
+        }
+        COUNT_STAT(instance, due, windows[i].imageEnd - windows[i].imageBegin);
+    }
+    COUNT_STAT(instance, due, dueCount);
+
+    FindLatestDue(instance, windows, windowCount, dueCount);
+    WriteLatestDue(instance, windows, windowCount);
+    FlushWrites(instance);
+
+    for(uint32_t due = 0; due < dueCount; due++) {
+        if(instance->periods[dueSlots[due]] != 0) {
+            Reschedule(instance, dueSlots[due], now);
+        }
+    }
+
+#ifdef LIGHTSCHEDULER_STATS
+    CountRunCycles(instance, LIGHTSCHEDULER_STATS_CYCLE_COUNT() - startCycles);
+#endif
+}
+
+enum {
+    AdlerModulus = 65521,
+    // most bytes that can be summed before the second sum could overflow 32 bits
+    AdlerBlockLength = 5552
+};
+
+static uint32_t SnapshotChecksum(const uint8_t *bytes, uint32_t length)
+{
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    while(length > 0) {
+        uint32_t block = (length < AdlerBlockLength) ? length : AdlerBlockLength;
+        length -= block;
+
+        for(uint32_t i = 0; i < block; i++) {
+            a += *bytes++;
+            b += a;
+        }
+
+        a %= AdlerModulus;
+        b %= AdlerModulus;
+    }
+
+    return (b << 16) | a;
+}
+
+// fields are copied a byte at a time so that a snapshot can be at any alignment
+static uint8_t *PutField(uint8_t *to, const void *field, size_t size)
+{
+    memcpy(to, field, size);
+    return to + size;
+}
+
+static const uint8_t *GetField(const uint8_t *from, void *field, size_t size)
+{
+    memcpy(field, from, size);
+    return from + size;
+}
+
+static uint8_t *PutRecord(uint8_t *to, const LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    const Schedule_t *schedule = &instance->schedules[slot];
+    ScheduleTicks_t time = schedule->time;
+    LightSchedulerLightId_t lightId = schedule->lightId;
+    uint8_t lightState = schedule->lightState;
+    uint32_t remainingRuns = (instance->periods[slot] > 0) ? instance->remainingRuns[slot] : 0;
+
+    to = PutField(to, &time, sizeof(time));
+    to = PutField(to, &instance->periods[slot], sizeof(ScheduleTicks_t));
+    to = PutField(to, &remainingRuns, sizeof(remainingRuns));
+    to = PutField(to, &lightId, sizeof(lightId));
+    return PutField(to, &lightState, sizeof(lightState));
+}
+
+static const uint8_t *GetRecord(const uint8_t *from, LightScheduler_t *instance, ScheduleSlot_t slot)
+{
+    ScheduleTicks_t time;
+    LightSchedulerLightId_t lightId;
+    uint8_t lightState;
+
+    from = GetField(from, &time, sizeof(time));
+    from = GetField(from, &instance->periods[slot], sizeof(ScheduleTicks_t));
+    from = GetField(from, &instance->remainingRuns[slot], sizeof(uint32_t));
+    from = GetField(from, &lightId, sizeof(lightId));
+    from = GetField(from, &lightState, sizeof(lightState));
+
+    instance->schedules[slot].time = time;
+    instance->schedules[slot].lightId = lightId;
+    instance->schedules[slot].lightState = lightState;
+    return from;
+}
+
+uint32_t LightScheduler_SnapshotSize(const LightScheduler_t *instance)
+{
+    return LIGHTSCHEDULER_SNAPSHOT_SIZE(instance->scheduleCount);
+}
+
+LightSchedulerSnapshotStatus_t LightScheduler_Serialize(
+    const LightScheduler_t *instance,
+    uint8_t *snapshot,
+    uint32_t size,
+    uint32_t *written)
+{
+    uint32_t snapshotSize = LightScheduler_SnapshotSize(instance);
+
+    if(size < snapshotSize) {
+        return LightSchedulerSnapshotStatus_BufferTooSmall;
+    }
+
+    uint32_t magic = LIGHTSCHEDULER_SNAPSHOT_MAGIC;
+    uint16_t version = LIGHTSCHEDULER_SNAPSHOT_VERSION;
+    uint8_t tickBits = LIGHTSCHEDULER_TICK_BITS;
+    uint8_t lightIdBits = LIGHTSCHEDULER_LIGHT_ID_BITS;
+
+    uint8_t *to = snapshot;
+    to = PutField(to, &magic, sizeof(magic));
+    to = PutField(to, &version, sizeof(version));
+    to = PutField(to, &tickBits, sizeof(tickBits));
+    to = PutField(to, &lightIdBits, sizeof(lightIdBits));
+    to = PutField(to, &instance->scheduleCount, sizeof(instance->scheduleCount));
+
+    // each light's list starts with its newest schedule, so it is written from the tail back
+    for(uint32_t lightId = 0; lightId < LIGHTSCHEDULER_LIGHT_COUNT; lightId++) {
+        ScheduleSlot_t slot = instance->lightHeads[lightId];
+
+        if(slot == LIGHTSCHEDULER_NO_SLOT) {
+            continue;
+        }
+
+        while(instance->nextSlots[slot] != LIGHTSCHEDULER_NO_SLOT) {
+            slot = instance->nextSlots[slot];
+        }
+
+        for(; slot != LIGHTSCHEDULER_NO_SLOT; slot = instance->previousSlots[slot]) {
+            to = PutRecord(to, instance, slot);
         }
     }
-}
\ No newline at end of file
+
+    uint32_t checksum = SnapshotChecksum(snapshot, (uint32_t)(to - snapshot));
+    PutField(to, &checksum, sizeof(checksum));
+
+    if(written != NULL) {
+        *written = snapshotSize;
+    }
+
+    return LightSchedulerSnapshotStatus_Ok;
+}
+
+static LightSchedulerSnapshotStatus_t CheckSnapshot(const uint8_t *snapshot, uint32_t size, uint32_t *count)
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t tickBits;
+    uint8_t lightIdBits;
+
+    if(size < LIGHTSCHEDULER_SNAPSHOT_SIZE(0)) {
+        return LightSchedulerSnapshotStatus_NotASnapshot;
+    }
+
+    const uint8_t *from = snapshot;
+    from = GetField(from, &magic, sizeof(magic));
+    from = GetField(from, &version, sizeof(version));
+    from = GetField(from, &tickBits, sizeof(tickBits));
+    from = GetField(from, &lightIdBits, sizeof(lightIdBits));
+    from = GetField(from, count, sizeof(*count));
+
+    if(magic != LIGHTSCHEDULER_SNAPSHOT_MAGIC) {
+        return LightSchedulerSnapshotStatus_NotASnapshot;
+    }
+    if(version != LIGHTSCHEDULER_SNAPSHOT_VERSION) {
+        return LightSchedulerSnapshotStatus_UnsupportedVersion;
+    }
+    if(tickBits != LIGHTSCHEDULER_TICK_BITS || lightIdBits != LIGHTSCHEDULER_LIGHT_ID_BITS) {
+        return LightSchedulerSnapshotStatus_ConfigurationMismatch;
+    }
+
+    // the count is compared by division so that a corrupt count cannot overflow the size
+    uint32_t recordBytes = size - LIGHTSCHEDULER_SNAPSHOT_SIZE(0);
+    if(recordBytes % LIGHTSCHEDULER_SNAPSHOT_RECORD_SIZE != 0 || recordBytes / LIGHTSCHEDULER_SNAPSHOT_RECORD_SIZE != *count) {
+        return LightSchedulerSnapshotStatus_NotASnapshot;
+    }
+
+    uint32_t checksum;
+    GetField(snapshot + size - LIGHTSCHEDULER_SNAPSHOT_CHECKSUM_SIZE, &checksum, sizeof(checksum));
+    if(checksum != SnapshotChecksum(snapshot, size - LIGHTSCHEDULER_SNAPSHOT_CHECKSUM_SIZE)) {
+        return LightSchedulerSnapshotStatus_Corrupt;
+    }
+
+    for(uint32_t i = 0; i < *count; i++) {
+        LightSchedulerLightId_t lightId;
+        uint8_t lightState;
+
+        from += 2 * sizeof(ScheduleTicks_t) + sizeof(uint32_t);
+        from = GetField(from, &lightId, sizeof(lightId));
+        from = GetField(from, &lightState, sizeof(lightState));
+
+        if(!LightIdIsValid(lightId) || lightState > 1) {
+            return LightSchedulerSnapshotStatus_Corrupt;
+        }
+    }
+
+    return LightSchedulerSnapshotStatus_Ok;
+}
+
+LightSchedulerSnapshotStatus_t LightScheduler_Deserialize(LightScheduler_t *instance, const uint8_t *snapshot, uint32_t size)
+{
+    uint32_t count;
+    LightSchedulerSnapshotStatus_t status = CheckSnapshot(snapshot, size, &count);
+
+    if(status != LightSchedulerSnapshotStatus_Ok) {
+        return status;
+    }
+    if(count > instance->maxSchedules) {
+        COUNT_STAT(instance, insertFailures, count);
+        return LightSchedulerSnapshotStatus_Full;
+    }
+
+    for(uint32_t lightId = 0; lightId < LIGHTSCHEDULER_LIGHT_COUNT; lightId++) {
+        RemoveSlotsForLight(instance, (LightSchedulerLightId_t)lightId);
+    }
+
+    // every slot is free now, so record i goes straight into slot i and the rest stay free in order
+    const uint8_t *from = snapshot + LIGHTSCHEDULER_SNAPSHOT_HEADER_SIZE;
+    for(ScheduleSlot_t slot = 0; slot < count; slot++) {
+        from = GetRecord(from, instance, slot);
+        SetSlotActive(instance, slot, true);
+        LinkToLight(instance, slot);
+    }
+
+    for(ScheduleSlot_t slot = count; slot < instance->maxSchedules; slot++) {
+        instance->nextSlots[slot] = slot + 1;
+    }
+    if(count < instance->maxSchedules) {
+        instance->nextSlots[instance->maxSchedules - 1] = LIGHTSCHEDULER_NO_SLOT;
+    }
+    instance->freeSlot = (count < instance->maxSchedules) ? count : LIGHTSCHEDULER_NO_SLOT;
+    instance->scheduleCount = count;
+
+    const ScheduleSlot_t *order = FindLoadOrder(instance, instance->schedules, count);
+    for(uint32_t i = 0; i < count; i++) {
+        ScheduleIndex_Insert(instance->index, instance->schedules[order[i]].time, order[i]);
+    }
+
+    return LightSchedulerSnapshotStatus_Ok;
+}
+
+bool LightScheduler_GetStats(const LightScheduler_t *instance, LightSchedulerStats_t *stats)
+{
+#ifdef LIGHTSCHEDULER_STATS
+    *stats = instance->stats;
+    return true;
+#else
+    (void)instance;
+    memset(stats, 0, sizeof(*stats));
+    return false;
+#endif
+}
+
+void LightScheduler_ResetStats(LightScheduler_t *instance)
+{
+#ifdef LIGHTSCHEDULER_STATS
+    memset(&instance->stats, 0, sizeof(instance->stats));
+    instance->stats.minCycles = UINT32_MAX;
+#else
+    (void)instance;
+#endif
+}
@@ -12,25 +12,292 @@
 
 #include "I_TimeSource.h"
 #include "I_DigitalOutputGroup.h"
+#include "ScheduleTicks.h"
+#include "SortedScheduleIndex.h"
+#include "TimingWheelScheduleIndex.h"
 
+#ifndef MAX_SCHEDULES
 #define MAX_SCHEDULES (10)
+#endif
+
+/*!
+ * Width of a light ID in bits: 8, or 16 to address more than 256 channels of a digital output group.
+ */
+#ifndef LIGHTSCHEDULER_LIGHT_ID_BITS
+#define LIGHTSCHEDULER_LIGHT_ID_BITS (8)
+#endif
+
+#if LIGHTSCHEDULER_LIGHT_ID_BITS == 8
+typedef uint8_t LightSchedulerLightId_t;
+#elif LIGHTSCHEDULER_LIGHT_ID_BITS == 16
+typedef DigitalOutputChannel_t LightSchedulerLightId_t;
+#else
+#error "LIGHTSCHEDULER_LIGHT_ID_BITS must be 8 or 16"
+#endif
+
+/*!
+ * Number of distinct light IDs, every ID the light ID width can name by default.  Every
+ * LightScheduler_t, and so every shard and every plan of a double-buffered light scheduler, holds the
+ * head of a list of schedules and a due entry for each light, and two bits for its shadow: about 8
+ * bytes per light, or 2 KB for the 256 lights of 8-bit light IDs and 528 KB for the 65,536 of 16-bit
+ * light IDs.  Define it as the number of lights actually used to save memory; light IDs from there
+ * on are then rejected.
+ */
+#ifndef LIGHTSCHEDULER_LIGHT_COUNT
+#define LIGHTSCHEDULER_LIGHT_COUNT (1UL << LIGHTSCHEDULER_LIGHT_ID_BITS)
+#endif
+
+#if LIGHTSCHEDULER_LIGHT_COUNT > (1UL << LIGHTSCHEDULER_LIGHT_ID_BITS)
+#error "LIGHTSCHEDULER_LIGHT_COUNT must fit in LIGHTSCHEDULER_LIGHT_ID_BITS"
+#endif
 
+/*!
+ * Number of 32-bit words in a bitmap with one bit per light.
+ */
+#define LIGHTSCHEDULER_LIGHT_WORDS ((LIGHTSCHEDULER_LIGHT_COUNT + 31) / 32)
+
+/*!
+ * Most writes collected before they are handed to a digital output group that supports WriteMany.
+ */
+#ifndef LIGHTSCHEDULER_WRITE_BATCH_SIZE
+#define LIGHTSCHEDULER_WRITE_BATCH_SIZE (16)
+#endif
+
+/*!
+ * Define LIGHTSCHEDULER_STATS to count what the light scheduler does and how long each run takes.
+ * Without it, nothing is counted and LightSchedulerStats_t takes no room in LightScheduler_t.  Runs
+ * are timed with LIGHTSCHEDULER_STATS_CYCLE_COUNT(), which returns a free-running 32-bit count; it
+ * reads the time stamp counter on x86 and must be defined for other targets, e.g. to read the DWT
+ * cycle counter on a Cortex-M.
+ */
+#ifdef LIGHTSCHEDULER_STATS
+#ifndef LIGHTSCHEDULER_STATS_CYCLE_COUNT
+#if defined(__x86_64__) || defined(__i386__)
+#define LIGHTSCHEDULER_STATS_CYCLE_COUNT() ((uint32_t)__builtin_ia32_rdtsc())
+#else
+#error "Define LIGHTSCHEDULER_STATS_CYCLE_COUNT() to read a cycle counter on this target"
+#endif
+#endif
+#endif
+
+/*!
+ * Number of buckets in the histogram of cycles per run.  Bucket n counts the runs that took from
+ * 2^n up to 2^(n+1) - 1 cycles; bucket 0 also counts runs that took 0 cycles.
+ */
+#define LIGHTSCHEDULER_STATS_HISTOGRAM_BUCKETS (32)
+
+/*!
+ * What a light scheduler has done since it was initialized or its statistics were reset.  The counts
+ * wrap around when they overflow.
+ */
 typedef struct
 {
-   bool active;
-   uint8_t lightId;
+   uint32_t runs;
+   uint32_t minCycles;
+   uint32_t maxCycles;
+   uint32_t cycleHistogram[LIGHTSCHEDULER_STATS_HISTOGRAM_BUCKETS];
+   uint32_t due;
+   uint32_t writes;
+   uint32_t insertFailures;
+} LightSchedulerStats_t;
+
+/*!
+ * Define LIGHTSCHEDULER_PACKED_SCHEDULES to store schedules without padding.  With 16-bit schedule
+ * ticks and 8-bit light IDs a schedule is 4 bytes either way; packing saves 2 bytes a schedule with
+ * 32-bit ticks and 6 with 64-bit ticks, and 1 with 16-bit light IDs, at the cost of unaligned
+ * reads.  Images and tables handed to the light scheduler must be built with the same setting.
+ */
+#ifdef LIGHTSCHEDULER_PACKED_SCHEDULES
+#define LIGHTSCHEDULER_SCHEDULE_PACKING __attribute__((packed))
+#else
+#define LIGHTSCHEDULER_SCHEDULE_PACKING
+#endif
+
+typedef struct LIGHTSCHEDULER_SCHEDULE_PACKING
+{
+   LightSchedulerLightId_t lightId;
    bool lightState;
-   TimeSourceTickCount_t time;
+   ScheduleTicks_t time;
 } Schedule_t;
 
+/*!
+ * Identifies one added schedule.  The generation changes every time a slot is freed, so a handle to a
+ * schedule that has been removed never matches a later schedule that reuses its slot.
+ */
 typedef struct
 {
-   uint8_t maxSchedules;
-   Schedule_t schedules[MAX_SCHEDULES];
+   ScheduleSlot_t slot;
+   uint16_t generation;
+} LightSchedulerHandle_t;
+
+/*!
+ * Slot number that marks the end of a list of slots.
+ */
+#define LIGHTSCHEDULER_NO_SLOT ((ScheduleSlot_t)UINT32_MAX)
+
+/*!
+ * Run count for a recurring schedule that keeps running until it is removed.
+ */
+#define LIGHTSCHEDULER_REPEAT_FOREVER (0)
+
+typedef enum
+{
+   LightSchedulerStatus_Ok,
+   LightSchedulerStatus_Full
+} LightSchedulerStatus_t;
+
+typedef enum
+{
+   LightSchedulerSnapshotStatus_Ok,
+   LightSchedulerSnapshotStatus_BufferTooSmall,
+   LightSchedulerSnapshotStatus_NotASnapshot,
+   LightSchedulerSnapshotStatus_UnsupportedVersion,
+   LightSchedulerSnapshotStatus_ConfigurationMismatch,
+   LightSchedulerSnapshotStatus_Corrupt,
+   LightSchedulerSnapshotStatus_Full
+} LightSchedulerSnapshotStatus_t;
+
+/*!
+ * Snapshot format.  A snapshot is a header, one record per schedule and a checksum, with every field
+ * in the byte order of the light scheduler that wrote it:
+ *
+ *    header:   magic (4 bytes), version (2), tick bits (1), light ID bits (1), record count (4)
+ *    record:   time, period (ScheduleTicks_t each), remaining runs (4), light ID, light state (1)
+ *    checksum: Adler-32 of the header and the records (4)
+ *
+ * The magic does not match when read with the other byte order, so a snapshot is only restored by a
+ * light scheduler with the same byte order, tick width and light ID width as the one that wrote it.
+ */
+#define LIGHTSCHEDULER_SNAPSHOT_MAGIC (0x4C53534EUL)
+#define LIGHTSCHEDULER_SNAPSHOT_VERSION (1)
+#define LIGHTSCHEDULER_SNAPSHOT_HEADER_SIZE (12)
+#define LIGHTSCHEDULER_SNAPSHOT_CHECKSUM_SIZE (4)
+#define LIGHTSCHEDULER_SNAPSHOT_RECORD_SIZE \
+   (2 * sizeof(ScheduleTicks_t) + sizeof(uint32_t) + sizeof(LightSchedulerLightId_t) + 1)
+
+/*!
+ * Number of bytes in a snapshot of count schedules.
+ */
+#define LIGHTSCHEDULER_SNAPSHOT_SIZE(count) \
+   (LIGHTSCHEDULER_SNAPSHOT_HEADER_SIZE + (count) * LIGHTSCHEDULER_SNAPSHOT_RECORD_SIZE + LIGHTSCHEDULER_SNAPSHOT_CHECKSUM_SIZE)
+
+/*!
+ * Unit of schedule storage.  Storage handed to the light scheduler is an array of these so that every
+ * table carved out of it is suitably aligned.
+ */
+typedef uint64_t LightSchedulerStorage_t;
+
+#define LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, type) \
+   (((capacity) * sizeof(type) + sizeof(LightSchedulerStorage_t) - 1) / sizeof(LightSchedulerStorage_t))
+
+#define LIGHTSCHEDULER_ACTIVE_SLOT_WORDS(capacity) (((capacity) + 31) / 32)
+
+/*!
+ * The time index has room for a quarter more entries than there are slots, so that removed entries
+ * only have to be compacted out of it after many replacements instead of on every one.
+ */
+#define LIGHTSCHEDULER_INDEX_CAPACITY(capacity) ((capacity) + (capacity) / 4)
+
+/*!
+ * Storage every light scheduler needs for capacity schedules, whichever index it uses.
+ */
+#define LIGHTSCHEDULER_SLOT_STORAGE_LENGTH(capacity) \
+   (LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(LIGHTSCHEDULER_ACTIVE_SLOT_WORDS(capacity), uint32_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, ScheduleSlot_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, ScheduleSlot_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, uint16_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, Schedule_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, ScheduleTicks_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, uint32_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, ScheduleSlot_t))
+
+/*!
+ * Number of LightSchedulerStorage_t elements needed to hold capacity schedules in a light scheduler
+ * that keeps them in a sorted index.
+ */
+#define LIGHTSCHEDULER_STORAGE_LENGTH(capacity) \
+   (LIGHTSCHEDULER_SLOT_STORAGE_LENGTH(capacity) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(LIGHTSCHEDULER_INDEX_CAPACITY(capacity), ScheduleSlot_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(LIGHTSCHEDULER_INDEX_CAPACITY(capacity), ScheduleTicks_t))
+
+/*!
+ * Number of LightSchedulerStorage_t elements needed to hold capacity schedules in a light scheduler
+ * that keeps them in a timing wheel with the given number of buckets.
+ */
+#define LIGHTSCHEDULER_TIMING_WHEEL_STORAGE_LENGTH(capacity, buckets) \
+   (LIGHTSCHEDULER_SLOT_STORAGE_LENGTH(capacity) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, ScheduleTicks_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, ScheduleSlot_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(capacity, ScheduleSlot_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(buckets, ScheduleSlot_t) + \
+    LIGHTSCHEDULER_STORAGE_ARRAY_LENGTH(TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(buckets), uint32_t))
+
+struct LightSchedulerCommand_t;
+struct LightSchedulerCommandQueue_t;
+struct I_LightSchedulerChangeLog_t;
+
+/*!
+ * Schedule storage is split by how often it is read.  The time index is what Run touches; the schedule
+ * table is only read for schedules that are due.  Free slots are chained through nextSlots, starting
+ * at freeSlot, so adding a schedule does not search for room.  The slots in use for each light are
+ * chained through nextSlots and previousSlots, starting at lightHeads, so one light's schedules are
+ * found without searching.  A recurring schedule keeps its period and the number of runs it has
+ * left in periods and remainingRuns; one-time schedules have a period of 0.  Run copies the slots
+ * that are due into dueSlots, so that it does not depend on how the index is kept.  Schedules in a
+ * read-only image are not copied; Run walks the image with imageCursor.
+ */
+typedef struct
+{
+   uint32_t maxSchedules;
+   uint32_t scheduleCount;
+   ScheduleSlot_t freeSlot;
+   uint32_t *activeSlots;
+   ScheduleSlot_t *nextSlots;
+   ScheduleSlot_t *previousSlots;
+   uint16_t *generations;
+   Schedule_t *schedules;
+   ScheduleTicks_t *periods;
+   uint32_t *remainingRuns;
+   ScheduleSlot_t *dueSlots;
+   I_ScheduleIndex_t *index;
+   union
+   {
+      SortedScheduleIndex_t sorted;
+      TimingWheelScheduleIndex_t timingWheel;
+   } indexes;
+   bool indexIsSorted;
    I_DigitalOutputGroup_t *lights;
    I_TimeSource_t *timeSource;
+   struct LightSchedulerCommandQueue_t *commandQueue;
+   struct I_LightSchedulerChangeLog_t *changeLog;
+   uint16_t pendingWriteCount;
+   DigitalOutputWrite_t pendingWrites[LIGHTSCHEDULER_WRITE_BATCH_SIZE];
+   ScheduleSlot_t lightHeads[LIGHTSCHEDULER_LIGHT_COUNT];
+   uint32_t latestDueForLight[LIGHTSCHEDULER_LIGHT_COUNT];
+   bool hasRun;
+   ScheduleTicks_t lastRunTicks;
+   const Schedule_t *image;
+   uint32_t imageCount;
+   uint32_t imageCursor;
+   bool shadowEnabled;
+   uint32_t shadowKnown[LIGHTSCHEDULER_LIGHT_WORDS];
+   uint32_t shadowStates[LIGHTSCHEDULER_LIGHT_WORDS];
+#ifdef LIGHTSCHEDULER_STATS
+   LightSchedulerStats_t stats;
+#endif
+   LightSchedulerStorage_t defaultStorage[LIGHTSCHEDULER_STORAGE_LENGTH(MAX_SCHEDULES)];
 } LightScheduler_t;
 
+/*!
+ * Walks the schedules for one light.  Only valid until a schedule is added or, other than the one
+ * just returned, removed.
+ */
+typedef struct
+{
+   const LightScheduler_t *scheduler;
+   ScheduleSlot_t slot;
+} LightSchedulerLightIterator_t;
+
 /*!
  * Initialize a light scheduler.
  * @param instance The light scheduler.
@@ -41,29 +308,374 @@ typedef struct
 void LightScheduler_Init(LightScheduler_t *instance, I_DigitalOutputGroup_t *lights, I_TimeSource_t *timeSource);
 
 /*!
- * Schedule a light to be turned on/off.
+ * Initialize a light scheduler that keeps its schedules in caller-owned storage instead of the
+ * MAX_SCHEDULES entries built into LightScheduler_t.  Its schedules are indexed in a sorted array,
+ * so adding one takes O(n) to shift later schedules along, unless it is due no earlier than every
+ * schedule already added.  Use LightScheduler_InitWithTimingWheel for constant-time adds.
+ * @param instance The light scheduler.
+ * @param lights A digital output group that can be used to control the lights.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param storage Storage for the schedules, at least LIGHTSCHEDULER_STORAGE_LENGTH(maxSchedules) long.
+ *    It must stay valid for as long as the light scheduler is used.
+ * @param maxSchedules The number of schedules that fit in the storage.
+ */
+void LightScheduler_InitWithStorage(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   LightSchedulerStorage_t *storage,
+   uint32_t maxSchedules);
+
+/*!
+ * Initialize a light scheduler that keeps its schedules in a hashed timing wheel in caller-owned
+ * storage.  Adding and removing a schedule take constant time however many schedules there are, and
+ * a run costs time proportional to the schedules that share a bucket with the ticks it covers.
+ * Better than the sorted index for very many schedules, as long as there are enough buckets.
+ * @pre buckets is a power of two
+ * @param instance The light scheduler.
+ * @param lights A digital output group that can be used to control the lights.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param storage Storage for the schedules, at least
+ *    LIGHTSCHEDULER_TIMING_WHEEL_STORAGE_LENGTH(maxSchedules, buckets) long.  It must stay valid for
+ *    as long as the light scheduler is used.
+ * @param maxSchedules The number of schedules that fit in the storage.
+ * @param buckets The number of buckets in the wheel.
+ */
+void LightScheduler_InitWithTimingWheel(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   LightSchedulerStorage_t *storage,
+   uint32_t maxSchedules,
+   uint32_t buckets);
+
+/*!
+ * Schedule a light to be turned on/off.  Finding a free slot takes constant time however full the
+ * table is; indexing the schedule takes constant time with a timing wheel and O(n) with the sorted
+ * index.
+ * @pre lightId < LIGHTSCHEDULER_LIGHT_COUNT
  * @param instance The light scheduler.
  * @param lightId The light ID that will be controlled by the scheduler.
  * @param lightState The state that will be written for the light (on/off).
  * @param time The light will be controlled when the time from the TimeSource reaches this value.
  *    The lightState should be written to the light with lightId at this time.
+ * @return A handle that can be used to remove the schedule.  If there was no room for the schedule
+ *    the handle's generation is 0 and it does not refer to any schedule.
  */
-void LightScheduler_AddSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time);
+LightSchedulerHandle_t LightScheduler_AddSchedule(LightScheduler_t *instance, LightSchedulerLightId_t lightId, bool lightState, ScheduleTicks_t time);
 
 /*!
- * Run a light scheduler.  The light scheduler will run all schedules that are due.
+ * Schedule a light to be turned on/off, reporting whether there was room for the schedule.  Takes as
+ * long as LightScheduler_AddSchedule.
+ * @pre lightId < LIGHTSCHEDULER_LIGHT_COUNT
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param time The light will be controlled when the time from the TimeSource reaches this value.
+ * @param handle Set to a handle for the added schedule.  May be NULL.
+ * @return LightSchedulerStatus_Full if every slot is in use and the schedule was not added.
+ */
+LightSchedulerStatus_t LightScheduler_TryAddSchedule(
+   LightScheduler_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time,
+   LightSchedulerHandle_t *handle);
+
+/*!
+ * Schedule many lights at once, e.g. from a table provisioned at boot or mapped in from a file.  The
+ * schedules are added as if by LightScheduler_AddSchedule in order of time, and in table order for
+ * schedules due at the same tick.  With the sorted index the table is sorted and then merged into the
+ * m schedules already added in one pass, which takes O(n log n + m) however the table is ordered, and
+ * O(n + m) if it is already in order of time; with a timing wheel it takes O(n).  Either every
+ * schedule is added or none are.
+ * @pre Every light ID in the table is less than LIGHTSCHEDULER_LIGHT_COUNT.
+ * @param instance The light scheduler.
+ * @param schedules The schedules to add.  Only read while the schedules are loaded.
+ * @param count The number of schedules.
+ * @return LightSchedulerStatus_Full if there are fewer free slots than schedules, in which case
+ *    nothing was added.
+ */
+LightSchedulerStatus_t LightScheduler_LoadSchedules(LightScheduler_t *instance, const Schedule_t *schedules, uint32_t count);
+
+/*!
+ * Run the schedules in a read-only image, e.g. a table in flash or a mapped file, alongside the ones
+ * that are added, without copying them.  Each entry runs like a schedule added with
+ * LightScheduler_AddSchedule before any other schedule, so added schedules win over image entries
+ * for the same light due at the same tick.  Image entries are not counted by
+ * LightScheduler_ScheduleCount and cannot be removed; they all stop running when another image is
+ * used instead.
+ * @pre The image is in order of time.
+ * @pre Every light ID in the image is less than LIGHTSCHEDULER_LIGHT_COUNT.
+ * @param instance The light scheduler.
+ * @param image The image.  It must stay valid and unchanged for as long as it is used.  May be NULL
+ *    if count is 0, to stop using an image.
+ * @param count The number of entries in the image.
+ */
+void LightScheduler_UseScheduleImage(LightScheduler_t *instance, const Schedule_t *image, uint32_t count);
+
+/*!
+ * Schedule a light to be turned on/off every period ticks.  Each time the schedule runs its time
+ * moves on by period, and it is ordered as if it had been added again at its new time.  Occurrences
+ * that come due in the same run are written once and all count as runs.
+ * @pre period > 0
+ * @pre lightId < LIGHTSCHEDULER_LIGHT_COUNT
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param firstTime The time the schedule first runs.
+ * @param period The number of ticks between runs.
+ * @param count The number of times to run the schedule, or LIGHTSCHEDULER_REPEAT_FOREVER.  The
+ *    schedule is removed after its last run.
+ * @return A handle that refers to the schedule until it is removed.  If there was no room for the
+ *    schedule the handle's generation is 0 and it does not refer to any schedule.
+ */
+LightSchedulerHandle_t LightScheduler_AddRecurringSchedule(
+   LightScheduler_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t firstTime,
+   ScheduleTicks_t period,
+   uint32_t count);
+
+/*!
+ * @param instance The light scheduler.
+ * @return The number of schedules currently scheduled.
+ */
+uint32_t LightScheduler_ScheduleCount(const LightScheduler_t *instance);
+
+/*!
+ * @param instance The light scheduler.
+ * @return The tick of the last run, extended to LIGHTSCHEDULER_TICK_BITS.  Schedules added for a
+ *    later tick are run when the schedule ticks reach it; schedules added for an earlier tick are run
+ *    after the schedule ticks wrap around.  0 before the first run.
+ */
+ScheduleTicks_t LightScheduler_CurrentTicks(const LightScheduler_t *instance);
+
+/*!
+ * Find when the next schedule is due, so that the caller can sleep until then instead of running the
+ * light scheduler every tick.  Searches from the tick after the last run (from tick 0 before the
+ * first run), wrapping around to the earliest schedule if none is due before the schedule ticks
+ * wrap.  Takes O(log n) with the sorted index, or O(n) when a long run of removed schedules has to be
+ * compacted out of it first; see SortedScheduleIndex_NextDue, and TimingWheelScheduleIndex_NextDue
+ * for the wheel.
+ * @param instance The light scheduler.
+ * @param tick Set to the tick, in the same ticks as LightScheduler_CurrentTicks.
+ * @return False if there are no schedules.
+ */
+bool LightScheduler_NextDueTick(LightScheduler_t *instance, ScheduleTicks_t *tick);
+
+/*!
+ * Find how long until the next schedule is due.  When schedule ticks are wider than the time
+ * source's, the light scheduler must still be run less than 65,536 time source ticks apart however
+ * far away the next schedule is.
+ * @param instance The light scheduler.
+ * @param ticks Set to the number of ticks from the last run until the next schedule is due, or
+ *    SCHEDULETICKS_MAX if the only schedules are due at the last run's tick and so a whole wrap of the
+ *    schedule ticks away.
+ * @return False if there are no schedules.
+ */
+bool LightScheduler_TicksUntilDue(LightScheduler_t *instance, ScheduleTicks_t *ticks);
+
+/*!
+ * Apply the schedule changes queued by another thread at the start of every run.  Once a queue is
+ * used, the other thread must only change schedules through it; every other call is still made from
+ * the thread that runs the light scheduler.
+ * @param instance The light scheduler.
+ * @param queue The queue, or NULL to stop using one.
+ */
+void LightScheduler_UseCommandQueue(LightScheduler_t *instance, struct LightSchedulerCommandQueue_t *queue);
+
+/*!
+ * Append every change to the schedules to a change log as it is made: each schedule that is added,
+ * each call that removes schedules, and each time a run moves a recurring schedule on, logged as
+ * removing it and adding it again at its next run.  Changes that do not change any schedule and
+ * restoring a snapshot are not logged, so a new log should be started whenever a snapshot is taken or
+ * restored.
+ * @param instance The light scheduler.
+ * @param changeLog The change log, or NULL to stop logging.
+ */
+void LightScheduler_UseChangeLog(LightScheduler_t *instance, struct I_LightSchedulerChangeLog_t *changeLog);
+
+/*!
+ * Make one change to the schedules, as the function for its type would, e.g. to replay a change log
+ * over the snapshot it was started from.  The change is logged if a change log is used, so replay
+ * before using one.  A change of an unknown type, or for a light ID that is not less than
+ * LIGHTSCHEDULER_LIGHT_COUNT, is ignored.
+ * @param instance The light scheduler.
+ * @param command The change.
+ */
+void LightScheduler_ApplyCommand(LightScheduler_t *instance, const struct LightSchedulerCommand_t *command);
+
+/*!
+ * Run a light scheduler.  The light scheduler will run all schedules that came due since it last ran,
+ * i.e. in the ticks after the previous run's tick up to and including the current tick, so ticks
+ * missed between runs are caught up.  The first run only runs the schedules due at the current tick,
+ * and a run at the same tick as the previous run runs nothing.  Each light is written at most once
+ * per run: when several schedules for one light are due, the one due last wins, and of those due at
+ * the same tick the one that was added last wins.  A recurring schedule that came due more than once
+ * is due at its last occurrence, and was added again at the occurrence before.  If the digital output
+ * group supports WriteMany, the writes for the due schedules are made together in as few WriteMany
+ * calls as LIGHTSCHEDULER_WRITE_BATCH_SIZE allows.
+ *
+ * If a command queue is used, the commands queued so far are applied first, so a schedule queued for
+ * the current tick runs in this run.  At most as many commands as the queue holds are applied per
+ * run, so a busy producer cannot hold up the run.
+ *
+ * The time source's ticks are extended to LIGHTSCHEDULER_TICK_BITS, so when schedule ticks are
+ * wider than the time source's, runs must be less than 65,536 time source ticks apart.
  * @param instance The light scheduler.
  */
 void LightScheduler_Run(LightScheduler_t *instance);
 
 /*!
- * Remove a light schedule.
+ * Start remembering the state last written to each light, so that Run skips writes that would not
+ * change a light.  Every light starts out unknown and is written the first time it is due.  Only
+ * use this when nothing but the light scheduler writes to the lights.
+ * @param instance The light scheduler.
+ */
+void LightScheduler_EnableShadow(LightScheduler_t *instance);
+
+/*!
+ * Write the remembered state to every light that the light scheduler has written since the shadow
+ * was enabled, e.g. after the digital output group's driver was reset.  Does nothing if the shadow
+ * is not enabled.
+ * @param instance The light scheduler.
+ */
+void LightScheduler_ResyncShadow(LightScheduler_t *instance);
+
+/*!
+ * Carry on from where another light scheduler driving the same lights left off, e.g. when a new plan
+ * built in a second light scheduler replaces the one that was running.  The tick of the last run and
+ * the shadow are copied, so the next run catches up from the previous one's last run and does not
+ * rewrite lights that are already in the right state, and the statistics are copied so that they
+ * cover both.  The command queue and change log are moved, so the previous light scheduler no longer
+ * uses them.  Schedules and the schedule image are not copied.
+ * @param instance The light scheduler that carries on.
+ * @param previous The light scheduler that was running.
+ */
+void LightScheduler_TakeOverFrom(LightScheduler_t *instance, LightScheduler_t *previous);
+
+/*!
+ * Remove a light schedule.  Every schedule that matches is removed.
  * @param instance The light scheduler.
  * @param lightId The light ID that will be controlled by the scheduler.
  * @param lightState The state that will be written for the light (on/off).
  * @param time The light will be controlled when the time from the TimeSource reaches this value.
  *    The lightState should be written to the light with lightId at this time.
  */
-void LightScheduler_RemoveSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time);
+void LightScheduler_RemoveSchedule(LightScheduler_t *instance, LightSchedulerLightId_t lightId, bool lightState, ScheduleTicks_t time);
+
+/*!
+ * Remove every schedule for a light, e.g. when its fixture is taken out of service.  Takes time
+ * proportional to the number of schedules for the light.  Entries in a schedule image are not removed.
+ * @param instance The light scheduler.
+ * @param lightId The light ID.
+ * @return The number of schedules removed, which is 0 if lightId is not less than
+ *    LIGHTSCHEDULER_LIGHT_COUNT.
+ */
+uint32_t LightScheduler_RemoveAllForLight(LightScheduler_t *instance, LightSchedulerLightId_t lightId);
+
+/*!
+ * Start walking the schedules for a light, most recently added first.  A recurring schedule counts as
+ * added again each time it runs.  Entries in a schedule image are not included.
+ * @pre lightId < LIGHTSCHEDULER_LIGHT_COUNT
+ * @param instance The light scheduler.
+ * @param lightId The light ID.
+ * @param iterator Set up to walk the light's schedules.
+ */
+void LightScheduler_IterateLight(
+   const LightScheduler_t *instance,
+   LightSchedulerLightId_t lightId,
+   LightSchedulerLightIterator_t *iterator);
+
+/*!
+ * Get the next schedule for a light.  The schedule may be removed with its handle before moving on.
+ * @param iterator The iterator.
+ * @param schedule Set to the schedule.  A recurring schedule's time is the time it next runs.
+ * @param handle Set to a handle for the schedule.  May be NULL.
+ * @return False if there are no more schedules for the light.
+ */
+bool LightScheduler_NextForLight(LightSchedulerLightIterator_t *iterator, Schedule_t *schedule, LightSchedulerHandle_t *handle);
+
+/*!
+ * Remove the one schedule a handle refers to, without searching for it.
+ * @param instance The light scheduler.
+ * @param handle The handle returned when the schedule was added.
+ * @return True if the schedule was removed, false if the handle is stale because its schedule was
+ *    already removed.
+ */
+bool LightScheduler_RemoveScheduleByHandle(LightScheduler_t *instance, LightSchedulerHandle_t handle);
+
+/*!
+ * Check whether a handle still refers to a scheduled schedule.
+ * @param instance The light scheduler.
+ * @param handle The handle returned when the schedule was added.
+ * @return True if the schedule has not been removed.
+ */
+bool LightScheduler_ScheduleExists(const LightScheduler_t *instance, LightSchedulerHandle_t handle);
+
+/*!
+ * @param instance The light scheduler.
+ * @return The number of bytes LightScheduler_Serialize needs for the schedules there are now.
+ */
+uint32_t LightScheduler_SnapshotSize(const LightScheduler_t *instance);
+
+/*!
+ * Write every added schedule to a snapshot that LightScheduler_Deserialize can restore, e.g. to
+ * persist the schedules across a reboot.  Each light's schedules are written in the order they were
+ * added, counting a recurring schedule as added again each time it runs, so the same one wins at a
+ * tick after a restore.  A recurring schedule is written with its next run, period and remaining
+ * runs.  Entries in a schedule image and the time of the last run are not included.  Takes
+ * O(n + LIGHTSCHEDULER_LIGHT_COUNT).
+ * @param instance The light scheduler.
+ * @param snapshot Set to the snapshot.
+ * @param size The number of bytes available at snapshot.
+ * @param written Set to the number of bytes written.  May be NULL.
+ * @return LightSchedulerSnapshotStatus_BufferTooSmall if the snapshot does not fit, in which case
+ *    nothing was written.
+ */
+LightSchedulerSnapshotStatus_t LightScheduler_Serialize(
+   const LightScheduler_t *instance,
+   uint8_t *snapshot,
+   uint32_t size,
+   uint32_t *written);
+
+/*!
+ * Replace every added schedule with the schedules in a snapshot written by LightScheduler_Serialize.
+ * The snapshot is checked completely before anything changes, and is read in place, so it may be a
+ * mapped file.  The schedules are copied straight into their slots instead of being added one by one,
+ * and are indexed in order of time, so this takes O(n log n) with the sorted index and O(n) with a
+ * timing wheel.  The schedules that are replaced are removed as if by
+ * LightScheduler_RemoveAllForLight, and handles to them stop matching.  Each light's schedules due
+ * at the same tick keep the order they were written in, so the same one wins.
+ * The schedule image, shadow and time of the last run are left as they are.
+ * @param instance The light scheduler.
+ * @param snapshot The snapshot.  Only read while it is restored.
+ * @param size The number of bytes in the snapshot.
+ * @return LightSchedulerSnapshotStatus_Ok if the schedules were replaced; otherwise nothing changed.
+ *    NotASnapshot if the size or magic is wrong, UnsupportedVersion or ConfigurationMismatch if the
+ *    snapshot was written by a different version or configuration, Corrupt if the checksum or a
+ *    record is wrong, and Full if there are more schedules than fit.
+ */
+LightSchedulerSnapshotStatus_t LightScheduler_Deserialize(LightScheduler_t *instance, const uint8_t *snapshot, uint32_t size);
+
+/*!
+ * Get what the light scheduler has done: the number of runs, the fewest and most cycles a run took
+ * and a histogram of them, the number of schedules and image entries found due, the number of writes
+ * made to lights, and the number of schedules that were not added because every slot was in use.
+ * A load or restore that does not fit adds none of its schedules, so all of them are counted.
+ * minCycles is UINT32_MAX before the first run.
+ * @param instance The light scheduler.
+ * @param stats Set to the statistics, or to all zeros if LIGHTSCHEDULER_STATS is not defined.
+ * @return False if LIGHTSCHEDULER_STATS is not defined and nothing is counted.
+ */
+bool LightScheduler_GetStats(const LightScheduler_t *instance, LightSchedulerStats_t *stats);
+
+/*!
+ * Start counting again from zero.  Does nothing if LIGHTSCHEDULER_STATS is not defined.
+ * @param instance The light scheduler.
+ */
+void LightScheduler_ResetStats(LightScheduler_t *instance);
 
 #endif
@@ -0,0 +1,39 @@
+/*!
+ * @file
+ * @brief One change to a light scheduler's schedules, as a record that can be queued, logged and
+ * applied later with LightScheduler_ApplyCommand.
+ */
+
+#ifndef LIGHTSCHEDULERCOMMAND_H
+#define LIGHTSCHEDULERCOMMAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "LightScheduler.h"
+
+typedef enum
+{
+   LightSchedulerCommandType_Add,
+   LightSchedulerCommandType_AddRecurring,
+   LightSchedulerCommandType_Remove,
+   LightSchedulerCommandType_RemoveAllForLight,
+   LightSchedulerCommandType_RemoveOne
+} LightSchedulerCommandType_t;
+
+/*!
+ * One schedule change.  The fields used depend on the type; period and count are only used by
+ * LightSchedulerCommandType_AddRecurring and LightSchedulerCommandType_RemoveOne.  RemoveOne removes
+ * a single schedule whose light, state, time, period and, for a recurring schedule, remaining runs
+ * all match, as removing it by its handle would; a one-time schedule has a period of 0.
+ */
+typedef struct LightSchedulerCommand_t
+{
+   uint8_t type;
+   bool lightState;
+   LightSchedulerLightId_t lightId;
+   ScheduleTicks_t time;
+   ScheduleTicks_t period;
+   uint32_t count;
+} LightSchedulerCommand_t;
+
+#endif
@@ -0,0 +1,97 @@
+/*!
+ * @file
+ * @brief Light scheduler command queue implementation.
+ */
+
+#include "LightSchedulerCommandQueue.h"
+#include "uassert.h"
+
+void LightSchedulerCommandQueue_Init(LightSchedulerCommandQueue_t *instance, LightSchedulerCommand_t *commands, uint32_t capacity)
+{
+   uassert((capacity > 0) && ((capacity & (capacity - 1)) == 0));
+
+   instance->commands = commands;
+   instance->mask = capacity - 1;
+   instance->head = 0;
+   instance->tail = 0;
+}
+
+// The release store of tail publishes the command written before it to the consumer's acquire load
+bool LightSchedulerCommandQueue_Push(LightSchedulerCommandQueue_t *instance, const LightSchedulerCommand_t *command)
+{
+   uint32_t tail = __atomic_load_n(&instance->tail, __ATOMIC_RELAXED);
+   uint32_t head = __atomic_load_n(&instance->head, __ATOMIC_ACQUIRE);
+
+   if(tail - head > instance->mask)
+   {
+      return false;
+   }
+
+   instance->commands[tail & instance->mask] = *command;
+   __atomic_store_n(&instance->tail, tail + 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+// The release store of head hands the command's storage back to the producer only once it is read
+bool LightSchedulerCommandQueue_Pop(LightSchedulerCommandQueue_t *instance, LightSchedulerCommand_t *command)
+{
+   uint32_t head = __atomic_load_n(&instance->head, __ATOMIC_RELAXED);
+   uint32_t tail = __atomic_load_n(&instance->tail, __ATOMIC_ACQUIRE);
+
+   if(head == tail)
+   {
+      return false;
+   }
+
+   *command = instance->commands[head & instance->mask];
+   __atomic_store_n(&instance->head, head + 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+static bool PushCommand(
+   LightSchedulerCommandQueue_t *instance,
+   LightSchedulerCommandType_t type,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time)
+{
+   LightSchedulerCommand_t command = { (uint8_t)type, lightState, lightId, time, 0, 0 };
+   return LightSchedulerCommandQueue_Push(instance, &command);
+}
+
+bool LightSchedulerCommandQueue_AddSchedule(
+   LightSchedulerCommandQueue_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time)
+{
+   return PushCommand(instance, LightSchedulerCommandType_Add, lightId, lightState, time);
+}
+
+bool LightSchedulerCommandQueue_AddRecurringSchedule(
+   LightSchedulerCommandQueue_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t firstTime,
+   ScheduleTicks_t period,
+   uint32_t count)
+{
+   uassert(period > 0);
+
+   LightSchedulerCommand_t command = { LightSchedulerCommandType_AddRecurring, lightState, lightId, firstTime, period, count };
+   return LightSchedulerCommandQueue_Push(instance, &command);
+}
+
+bool LightSchedulerCommandQueue_RemoveSchedule(
+   LightSchedulerCommandQueue_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time)
+{
+   return PushCommand(instance, LightSchedulerCommandType_Remove, lightId, lightState, time);
+}
+
+bool LightSchedulerCommandQueue_RemoveAllForLight(LightSchedulerCommandQueue_t *instance, LightSchedulerLightId_t lightId)
+{
+   return PushCommand(instance, LightSchedulerCommandType_RemoveAllForLight, lightId, false, 0);
+}
@@ -0,0 +1,104 @@
+/*!
+ * @file
+ * @brief Lock-free queue of schedule changes from one producer thread to the thread that runs a light
+ * scheduler.  The producer adds and removes schedules through the queue instead of calling the light
+ * scheduler, and the light scheduler applies them at the start of its next run, so neither thread
+ * ever waits for the other.
+ */
+
+#ifndef LIGHTSCHEDULERCOMMANDQUEUE_H
+#define LIGHTSCHEDULERCOMMANDQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "LightScheduler.h"
+#include "LightSchedulerCommand.h"
+
+/*!
+ * Size the producer's and the consumer's positions are kept apart by, so that updating one does not
+ * evict the other from the other thread's cache.
+ */
+#define LIGHTSCHEDULERCOMMANDQUEUE_CACHE_LINE_SIZE (64)
+
+/*!
+ * Ring of commands.  head and tail count every command popped and pushed and wrap around freely;
+ * only the consumer writes head and only the producer writes tail.  They are padded a cache line
+ * apart instead of aligned so that the queue can be allocated anywhere.
+ */
+typedef struct LightSchedulerCommandQueue_t
+{
+   LightSchedulerCommand_t *commands;
+   uint32_t mask;
+   uint32_t head;
+   uint8_t headPadding[LIGHTSCHEDULERCOMMANDQUEUE_CACHE_LINE_SIZE];
+   uint32_t tail;
+} LightSchedulerCommandQueue_t;
+
+/*!
+ * Initialize an empty queue.
+ * @pre capacity is a power of two
+ * @param instance The queue.
+ * @param commands Storage for capacity commands.  It must stay valid for as long as the queue is used.
+ * @param capacity The most commands the queue holds.
+ */
+void LightSchedulerCommandQueue_Init(LightSchedulerCommandQueue_t *instance, LightSchedulerCommand_t *commands, uint32_t capacity);
+
+/*!
+ * Queue a command.  Only call from the producer thread.
+ * @param instance The queue.
+ * @param command The command.
+ * @return False if the queue is full and the command was not queued.
+ */
+bool LightSchedulerCommandQueue_Push(LightSchedulerCommandQueue_t *instance, const LightSchedulerCommand_t *command);
+
+/*!
+ * Take the oldest command off the queue.  Only call from the consumer thread.
+ * @param instance The queue.
+ * @param command Set to the command.
+ * @return False if the queue is empty.
+ */
+bool LightSchedulerCommandQueue_Pop(LightSchedulerCommandQueue_t *instance, LightSchedulerCommand_t *command);
+
+/*!
+ * Queue adding a schedule, as LightScheduler_AddSchedule.  If the light scheduler has no room when the
+ * command is applied, the schedule is not added.  Only call from the producer thread.
+ * @return False if the queue is full and the command was not queued.
+ */
+bool LightSchedulerCommandQueue_AddSchedule(
+   LightSchedulerCommandQueue_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time);
+
+/*!
+ * Queue adding a recurring schedule, as LightScheduler_AddRecurringSchedule.  Only call from the
+ * producer thread.
+ * @pre period > 0
+ * @return False if the queue is full and the command was not queued.
+ */
+bool LightSchedulerCommandQueue_AddRecurringSchedule(
+   LightSchedulerCommandQueue_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t firstTime,
+   ScheduleTicks_t period,
+   uint32_t count);
+
+/*!
+ * Queue removing schedules, as LightScheduler_RemoveSchedule.  Only call from the producer thread.
+ * @return False if the queue is full and the command was not queued.
+ */
+bool LightSchedulerCommandQueue_RemoveSchedule(
+   LightSchedulerCommandQueue_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time);
+
+/*!
+ * Queue removing every schedule for a light, as LightScheduler_RemoveAllForLight.  Only call from the
+ * producer thread.
+ * @return False if the queue is full and the command was not queued.
+ */
+bool LightSchedulerCommandQueue_RemoveAllForLight(LightSchedulerCommandQueue_t *instance, LightSchedulerLightId_t lightId);
+
+#endif
@@ -0,0 +1,36 @@
+/*!
+ * @file
+ * @brief Tick count used for schedule times.  The time source's tick count wraps every 65,536 ticks;
+ * schedule times can be made wider so that schedules can be placed further ahead.  The light
+ * scheduler extends the time source's ticks to this width as it runs.
+ */
+
+#ifndef SCHEDULETICKS_H
+#define SCHEDULETICKS_H
+
+#include <stdint.h>
+#include "I_TimeSource.h"
+
+/*!
+ * Width of a schedule time in bits: 16, 32 or 64.
+ */
+#ifndef LIGHTSCHEDULER_TICK_BITS
+#define LIGHTSCHEDULER_TICK_BITS (16)
+#endif
+
+#if LIGHTSCHEDULER_TICK_BITS == 16
+typedef TimeSourceTickCount_t ScheduleTicks_t;
+#elif LIGHTSCHEDULER_TICK_BITS == 32
+typedef uint32_t ScheduleTicks_t;
+#elif LIGHTSCHEDULER_TICK_BITS == 64
+typedef uint64_t ScheduleTicks_t;
+#else
+#error "LIGHTSCHEDULER_TICK_BITS must be 16, 32 or 64"
+#endif
+
+/*!
+ * Last schedule time before the schedule ticks wrap around to 0.
+ */
+#define SCHEDULETICKS_MAX ((ScheduleTicks_t)~(ScheduleTicks_t)0)
+
+#endif
@@ -0,0 +1,170 @@
+/*!
+ * @file
+ * @brief Schedule time matching kernels.
+ */
+
+#include "ScheduleTimeMatch.h"
+#include "uassert.h"
+
+#ifdef SCHEDULETIMEMATCH_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+uint32_t ScheduleTimeMatch_DueMaskScalar(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks)
+{
+   uint32_t mask = 0;
+
+   for(uint32_t i = 0; i < count; i++)
+   {
+      mask |= (uint32_t)(times[i] == ticks) << i;
+   }
+
+   return mask;
+}
+
+#ifdef SCHEDULETIMEMATCH_X86_KERNELS
+
+// Shifting by the width of the mask is undefined, so a whole block has no tail to add
+static uint32_t TailMask(const ScheduleTicks_t *times, uint32_t i, uint32_t count, ScheduleTicks_t ticks)
+{
+   if(i == count)
+   {
+      return 0;
+   }
+
+   return ScheduleTimeMatch_DueMaskScalar(&times[i], count - i, ticks) << i;
+}
+
+#if LIGHTSCHEDULER_TICK_BITS == 16
+
+uint32_t ScheduleTimeMatch_DueMaskSse2(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks)
+{
+   const __m128i due = _mm_set1_epi16((short)ticks);
+   uint32_t mask = 0;
+   uint32_t i = 0;
+
+   // Only whole groups of eight are loaded so that nothing past the end of times is read
+   for(; i + 16 <= count; i += 16)
+   {
+      __m128i low = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&times[i]), due);
+      __m128i high = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&times[i + 8]), due);
+      mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(low, high)) << i;
+   }
+
+   for(; i + 8 <= count; i += 8)
+   {
+      __m128i matches = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&times[i]), due);
+      mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(matches, _mm_setzero_si128())) << i;
+   }
+
+   return mask | TailMask(times, i, count, ticks);
+}
+
+__attribute__((target("avx2"))) uint32_t ScheduleTimeMatch_DueMaskAvx2(
+   const ScheduleTicks_t *times,
+   uint32_t count,
+   ScheduleTicks_t ticks)
+{
+   if(count < SCHEDULETIMEMATCH_BLOCK_SIZE)
+   {
+      return ScheduleTimeMatch_DueMaskSse2(times, count, ticks);
+   }
+
+   const __m256i due = _mm256_set1_epi16((short)ticks);
+   __m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)&times[0]), due);
+   __m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)&times[16]), due);
+
+   // Packing works within 128-bit lanes, so put the lanes back in order before taking the mask
+   __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+   return (uint32_t)_mm256_movemask_epi8(packed);
+}
+
+#else
+
+static __m128i CompareFour(const ScheduleTicks_t *times, __m128i due)
+{
+   return _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)times), due);
+}
+
+uint32_t ScheduleTimeMatch_DueMaskSse2(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks)
+{
+   const __m128i due = _mm_set1_epi32((int)ticks);
+   uint32_t mask = 0;
+   uint32_t i = 0;
+
+   // Only whole groups of four are loaded so that nothing past the end of times is read
+   for(; i + 16 <= count; i += 16)
+   {
+      __m128i low = _mm_packs_epi32(CompareFour(&times[i], due), CompareFour(&times[i + 4], due));
+      __m128i high = _mm_packs_epi32(CompareFour(&times[i + 8], due), CompareFour(&times[i + 12], due));
+      mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(low, high)) << i;
+   }
+
+   for(; i + 8 <= count; i += 8)
+   {
+      __m128i matches = _mm_packs_epi32(CompareFour(&times[i], due), CompareFour(&times[i + 4], due));
+      mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(matches, _mm_setzero_si128())) << i;
+   }
+
+   return mask | TailMask(times, i, count, ticks);
+}
+
+__attribute__((target("avx2"))) uint32_t ScheduleTimeMatch_DueMaskAvx2(
+   const ScheduleTicks_t *times,
+   uint32_t count,
+   ScheduleTicks_t ticks)
+{
+   if(count < SCHEDULETIMEMATCH_BLOCK_SIZE)
+   {
+      return ScheduleTimeMatch_DueMaskSse2(times, count, ticks);
+   }
+
+   const __m256i due = _mm256_set1_epi32((int)ticks);
+   __m256i a = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&times[0]), due);
+   __m256i b = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&times[8]), due);
+   __m256i c = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&times[16]), due);
+   __m256i d = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&times[24]), due);
+
+   // Packing works within 128-bit lanes, which leaves each group of four bytes one lane away from
+   // its neighbour, so gather the groups back in order before taking the mask
+   __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+   packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+   return (uint32_t)_mm256_movemask_epi8(packed);
+}
+
+#endif
+
+bool ScheduleTimeMatch_Avx2Supported(void)
+{
+#ifdef __AVX2__
+   return true;
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static uint32_t SelectKernel(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks);
+
+// Schedulers on different threads may select at the same time; they all store the same kernel
+static ScheduleTimeMatch_DueMask_t kernel = SelectKernel;
+
+static uint32_t SelectKernel(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks)
+{
+   ScheduleTimeMatch_DueMask_t selected =
+      ScheduleTimeMatch_Avx2Supported() ? ScheduleTimeMatch_DueMaskAvx2 : ScheduleTimeMatch_DueMaskSse2;
+   __atomic_store_n(&kernel, selected, __ATOMIC_RELAXED);
+   return selected(times, count, ticks);
+}
+
+#else
+
+static ScheduleTimeMatch_DueMask_t kernel = ScheduleTimeMatch_DueMaskScalar;
+
+#endif
+
+uint32_t ScheduleTimeMatch_DueMask(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks)
+{
+   uassert(count <= SCHEDULETIMEMATCH_BLOCK_SIZE);
+   return __atomic_load_n(&kernel, __ATOMIC_RELAXED)(times, count, ticks);
+}
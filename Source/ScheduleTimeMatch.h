@@ -0,0 +1,60 @@
+/*!
+ * @file
+ * @brief Compares a block of packed schedule times against the current tick.  Vector kernels are used
+ * where the target supports them, with a portable scalar kernel that every other kernel must match.
+ */
+
+#ifndef SCHEDULETIMEMATCH_H
+#define SCHEDULETIMEMATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ScheduleTicks.h"
+
+/*!
+ * Most times compared by one call.
+ */
+#define SCHEDULETIMEMATCH_BLOCK_SIZE (32)
+
+// SSE2 has no 64-bit compare, so 64-bit schedule ticks use the scalar kernel
+#if (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))) && defined(__GNUC__) && \
+   !defined(SCHEDULETIMEMATCH_SCALAR_ONLY) && (LIGHTSCHEDULER_TICK_BITS != 64)
+#define SCHEDULETIMEMATCH_X86_KERNELS
+#endif
+
+typedef uint32_t (*ScheduleTimeMatch_DueMask_t)(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks);
+
+/*!
+ * Find which times in a block are due.  Uses the fastest kernel the CPU supports.
+ * @pre count <= SCHEDULETIMEMATCH_BLOCK_SIZE
+ * @param times The packed times.
+ * @param count The number of times to compare.
+ * @param ticks The current tick.
+ * @return A mask with bit i set if times[i] == ticks.  Bits at and above count are clear.
+ */
+uint32_t ScheduleTimeMatch_DueMask(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks);
+
+/*!
+ * Portable kernel.  Same contract as ScheduleTimeMatch_DueMask.
+ */
+uint32_t ScheduleTimeMatch_DueMaskScalar(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks);
+
+#ifdef SCHEDULETIMEMATCH_X86_KERNELS
+/*!
+ * SSE2 kernel.  Same contract as ScheduleTimeMatch_DueMask.
+ */
+uint32_t ScheduleTimeMatch_DueMaskSse2(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks);
+
+/*!
+ * AVX2 kernel.  Same contract as ScheduleTimeMatch_DueMask.
+ * @pre ScheduleTimeMatch_Avx2Supported()
+ */
+uint32_t ScheduleTimeMatch_DueMaskAvx2(const ScheduleTicks_t *times, uint32_t count, ScheduleTicks_t ticks);
+
+/*!
+ * @return True if the CPU can run the AVX2 kernel.
+ */
+bool ScheduleTimeMatch_Avx2Supported(void);
+#endif
+
+#endif
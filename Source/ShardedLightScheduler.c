@@ -0,0 +1,94 @@
+/*!
+ * @file
+ * @brief Sharded light scheduler implementation.
+ */
+
+#include "ShardedLightScheduler.h"
+#include "uassert.h"
+
+static TimeSourceTickCount_t GetLatchedTicks(I_TimeSource_t *instance)
+{
+   return ((ShardedLightSchedulerTickLatch_t *)instance)->ticks;
+}
+
+static const I_TimeSource_Api_t latchApi = { GetLatchedTicks };
+
+void ShardedLightScheduler_Init(
+   ShardedLightScheduler_t *instance,
+   I_TimeSource_t *timeSource,
+   LightScheduler_t *shards,
+   uint8_t shardCount)
+{
+   uassert(shardCount > 0);
+
+   instance->shards = shards;
+   instance->shardCount = shardCount;
+   instance->timeSource = timeSource;
+   instance->latch.interface.api = &latchApi;
+   instance->latch.ticks = 0;
+}
+
+void ShardedLightScheduler_InitShard(
+   ShardedLightScheduler_t *instance,
+   uint8_t shard,
+   I_DigitalOutputGroup_t *lights,
+   LightSchedulerStorage_t *storage,
+   uint32_t maxSchedules)
+{
+   uassert(shard < instance->shardCount);
+   LightScheduler_InitWithStorage(&instance->shards[shard], lights, &instance->latch.interface, storage, maxSchedules);
+}
+
+uint8_t ShardedLightScheduler_ShardForLight(const ShardedLightScheduler_t *instance, LightSchedulerLightId_t lightId)
+{
+   return (uint8_t)(lightId % instance->shardCount);
+}
+
+LightScheduler_t *ShardedLightScheduler_Shard(ShardedLightScheduler_t *instance, LightSchedulerLightId_t lightId)
+{
+   return &instance->shards[ShardedLightScheduler_ShardForLight(instance, lightId)];
+}
+
+LightSchedulerHandle_t ShardedLightScheduler_AddSchedule(
+   ShardedLightScheduler_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time)
+{
+   return LightScheduler_AddSchedule(ShardedLightScheduler_Shard(instance, lightId), lightId, lightState, time);
+}
+
+void ShardedLightScheduler_RemoveSchedule(
+   ShardedLightScheduler_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time)
+{
+   LightScheduler_RemoveSchedule(ShardedLightScheduler_Shard(instance, lightId), lightId, lightState, time);
+}
+
+uint32_t ShardedLightScheduler_RemoveAllForLight(ShardedLightScheduler_t *instance, LightSchedulerLightId_t lightId)
+{
+   return LightScheduler_RemoveAllForLight(ShardedLightScheduler_Shard(instance, lightId), lightId);
+}
+
+void ShardedLightScheduler_BeginTick(ShardedLightScheduler_t *instance)
+{
+   instance->latch.ticks = TimeSource_GetTicks(instance->timeSource);
+}
+
+void ShardedLightScheduler_RunShard(ShardedLightScheduler_t *instance, uint8_t shard)
+{
+   uassert(shard < instance->shardCount);
+   LightScheduler_Run(&instance->shards[shard]);
+}
+
+void ShardedLightScheduler_Run(ShardedLightScheduler_t *instance)
+{
+   ShardedLightScheduler_BeginTick(instance);
+
+   for(uint8_t shard = 0; shard < instance->shardCount; shard++)
+   {
+      ShardedLightScheduler_RunShard(instance, shard);
+   }
+}
@@ -0,0 +1,129 @@
+/*!
+ * @file
+ * @brief Light scheduler split into shards that can run on separate threads.  Lights are divided
+ * among the shards by light ID, so every schedule for a light is in the same shard, and each shard
+ * writes to its own digital output group.  The time source is read once per tick and every shard
+ * runs at that tick.
+ */
+
+#ifndef SHARDEDLIGHTSCHEDULER_H
+#define SHARDEDLIGHTSCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "LightScheduler.h"
+
+/*!
+ * Time source the shards run from.  Holds the ticks read at the start of the tick.
+ */
+typedef struct
+{
+   I_TimeSource_t interface;
+   TimeSourceTickCount_t ticks;
+} ShardedLightSchedulerTickLatch_t;
+
+typedef struct
+{
+   LightScheduler_t *shards;
+   uint8_t shardCount;
+   I_TimeSource_t *timeSource;
+   ShardedLightSchedulerTickLatch_t latch;
+} ShardedLightScheduler_t;
+
+/*!
+ * Initialize a sharded light scheduler.  Each shard must then be initialized with
+ * ShardedLightScheduler_InitShard.
+ * @pre shardCount > 0
+ * @param instance The sharded light scheduler.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param shards Storage for the shards, shardCount entries.
+ * @param shardCount The number of shards.
+ */
+void ShardedLightScheduler_Init(
+   ShardedLightScheduler_t *instance,
+   I_TimeSource_t *timeSource,
+   LightScheduler_t *shards,
+   uint8_t shardCount);
+
+/*!
+ * Initialize one shard, as LightScheduler_InitWithStorage.
+ * @pre shard < shardCount
+ * @param instance The sharded light scheduler.
+ * @param shard The shard.
+ * @param lights The digital output group for the shard's lights.  Light ID x will be channel x, as
+ *    for an unsharded light scheduler.
+ * @param storage Storage for the shard's schedules, at least LIGHTSCHEDULER_STORAGE_LENGTH(maxSchedules)
+ *    long.
+ * @param maxSchedules The number of schedules that fit in the shard.
+ */
+void ShardedLightScheduler_InitShard(
+   ShardedLightScheduler_t *instance,
+   uint8_t shard,
+   I_DigitalOutputGroup_t *lights,
+   LightSchedulerStorage_t *storage,
+   uint32_t maxSchedules);
+
+/*!
+ * @param instance The sharded light scheduler.
+ * @param lightId The light ID.
+ * @return The shard that holds a light's schedules.
+ */
+uint8_t ShardedLightScheduler_ShardForLight(const ShardedLightScheduler_t *instance, LightSchedulerLightId_t lightId);
+
+/*!
+ * @param instance The sharded light scheduler.
+ * @param lightId The light ID.
+ * @return The light scheduler that holds a light's schedules, for calls not made through the sharded
+ *    light scheduler.  Handles returned by the shard only refer to schedules in that shard.
+ */
+LightScheduler_t *ShardedLightScheduler_Shard(ShardedLightScheduler_t *instance, LightSchedulerLightId_t lightId);
+
+/*!
+ * Schedule a light to be turned on/off in the shard for the light, as LightScheduler_AddSchedule.
+ * @return A handle to the schedule in the shard for the light.
+ */
+LightSchedulerHandle_t ShardedLightScheduler_AddSchedule(
+   ShardedLightScheduler_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time);
+
+/*!
+ * Remove a light schedule from the shard for the light, as LightScheduler_RemoveSchedule.
+ */
+void ShardedLightScheduler_RemoveSchedule(
+   ShardedLightScheduler_t *instance,
+   LightSchedulerLightId_t lightId,
+   bool lightState,
+   ScheduleTicks_t time);
+
+/*!
+ * Remove every schedule for a light, as LightScheduler_RemoveAllForLight.
+ * @return The number of schedules removed.
+ */
+uint32_t ShardedLightScheduler_RemoveAllForLight(ShardedLightScheduler_t *instance, LightSchedulerLightId_t lightId);
+
+/*!
+ * Start a tick by reading the time source for every shard.  When the shards run on separate threads,
+ * call this before releasing them to run, e.g. before a barrier that the threads wait on, and do not
+ * call it again until every shard has finished running.
+ * @param instance The sharded light scheduler.
+ */
+void ShardedLightScheduler_BeginTick(ShardedLightScheduler_t *instance);
+
+/*!
+ * Run one shard at the tick read by ShardedLightScheduler_BeginTick, as LightScheduler_Run.  Different
+ * shards may be run at the same time on different threads.
+ * @pre shard < shardCount
+ * @param instance The sharded light scheduler.
+ * @param shard The shard.
+ */
+void ShardedLightScheduler_RunShard(ShardedLightScheduler_t *instance, uint8_t shard);
+
+/*!
+ * Run every shard in turn on the calling thread.
+ * @param instance The sharded light scheduler.
+ */
+void ShardedLightScheduler_Run(ShardedLightScheduler_t *instance);
+
+#endif
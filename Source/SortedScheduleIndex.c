@@ -0,0 +1,343 @@
+/*!
+ * @file
+ * @brief Sorted schedule index implementation.
+ */
+
+#include <string.h>
+#include "SortedScheduleIndex.h"
+#include "ScheduleTimeMatch.h"
+#include "uassert.h"
+
+enum
+{
+   CursorWalkLimit = 8
+};
+
+static uint32_t LowerBoundBetween(const SortedScheduleIndex_t *instance, uint32_t low, uint32_t high, ScheduleTicks_t time)
+{
+   while(low < high)
+   {
+      uint32_t middle = low + (high - low) / 2;
+
+      if(instance->times[middle] < time)
+      {
+         low = middle + 1;
+      }
+      else
+      {
+         high = middle;
+      }
+   }
+
+   return low;
+}
+
+static uint32_t UpperBound(const SortedScheduleIndex_t *instance, ScheduleTicks_t time)
+{
+   uint32_t low = 0;
+   uint32_t high = instance->count;
+
+   while(low < high)
+   {
+      uint32_t middle = low + (high - low) / 2;
+
+      if(instance->times[middle] <= time)
+      {
+         low = middle + 1;
+      }
+      else
+      {
+         high = middle;
+      }
+   }
+
+   return low;
+}
+
+static void Compact(SortedScheduleIndex_t *instance)
+{
+   uint32_t kept = 0;
+
+   for(uint32_t position = 0; position < instance->count; position++)
+   {
+      if(instance->slots[position] != SORTEDSCHEDULEINDEX_REMOVED_SLOT)
+      {
+         instance->times[kept] = instance->times[position];
+         instance->slots[kept] = instance->slots[position];
+         kept++;
+      }
+   }
+
+   instance->count = kept;
+   instance->removed = 0;
+   instance->cursor = 0;
+}
+
+// Compacting once more than half of the entries are removed keeps the cost of removal amortized O(1)
+static void CompactIfSparse(SortedScheduleIndex_t *instance)
+{
+   if(instance->removed * 2 > instance->count)
+   {
+      Compact(instance);
+   }
+}
+
+static void Insert(I_ScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   SortedScheduleIndex_Insert((SortedScheduleIndex_t *)instance, time, slot);
+}
+
+static bool Remove(I_ScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   return SortedScheduleIndex_Remove((SortedScheduleIndex_t *)instance, time, slot);
+}
+
+static uint32_t CollectDue(I_ScheduleIndex_t *instance, ScheduleTicks_t first, ScheduleTicks_t last, ScheduleSlot_t *slots)
+{
+   return SortedScheduleIndex_CollectDue((SortedScheduleIndex_t *)instance, first, last, slots);
+}
+
+static bool NextDue(I_ScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time)
+{
+   return SortedScheduleIndex_NextDue((SortedScheduleIndex_t *)instance, from, time);
+}
+
+static const I_ScheduleIndex_Api_t api = { Insert, Remove, CollectDue, NextDue };
+
+void SortedScheduleIndex_Init(
+   SortedScheduleIndex_t *instance,
+   ScheduleTicks_t *times,
+   ScheduleSlot_t *slots,
+   uint32_t capacity)
+{
+   instance->interface.api = &api;
+   instance->times = times;
+   instance->slots = slots;
+   instance->count = 0;
+   instance->removed = 0;
+   instance->capacity = capacity;
+   instance->cursor = 0;
+}
+
+void SortedScheduleIndex_Insert(SortedScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   if(instance->count == instance->capacity)
+   {
+      Compact(instance);
+   }
+   else
+   {
+      CompactIfSparse(instance);
+   }
+   uassert(instance->count < instance->capacity);
+
+   // Slots inserted in time order, as when loading many at once, go on the end without a search
+   uint32_t position = instance->count;
+   if((position > 0) && (instance->times[position - 1] > time))
+   {
+      position = UpperBound(instance, time);
+   }
+
+   uint32_t moved = instance->count - position;
+   memmove(&instance->times[position + 1], &instance->times[position], moved * sizeof(instance->times[0]));
+   memmove(&instance->slots[position + 1], &instance->slots[position], moved * sizeof(instance->slots[0]));
+
+   instance->times[position] = time;
+   instance->slots[position] = slot;
+   instance->count++;
+}
+
+void SortedScheduleIndex_InsertMany(
+   SortedScheduleIndex_t *instance,
+   const ScheduleSlot_t *slots,
+   uint32_t count,
+   SortedScheduleIndex_TimeOfSlot_t timeOf,
+   const void *context)
+{
+   if(count == 0)
+   {
+      return;
+   }
+
+   Compact(instance);
+   uassert(count <= instance->capacity - instance->count);
+
+   // Merged from the back so that each entry already in the index moves once, to its final position
+   uint32_t kept = instance->count;
+   uint32_t added = count;
+   uint32_t position = kept + count;
+   ScheduleTicks_t time = timeOf(context, slots[added - 1]);
+
+   while(added > 0)
+   {
+      position--;
+
+      if((kept > 0) && (instance->times[kept - 1] > time))
+      {
+         kept--;
+         instance->times[position] = instance->times[kept];
+         instance->slots[position] = instance->slots[kept];
+      }
+      else
+      {
+         added--;
+         instance->times[position] = time;
+         instance->slots[position] = slots[added];
+
+         if(added > 0)
+         {
+            time = timeOf(context, slots[added - 1]);
+         }
+      }
+   }
+
+   instance->count += count;
+}
+
+void SortedScheduleIndex_RemoveAt(SortedScheduleIndex_t *instance, uint32_t position)
+{
+   uassert(position < instance->count);
+   uassert(instance->slots[position] != SORTEDSCHEDULEINDEX_REMOVED_SLOT);
+
+   instance->slots[position] = SORTEDSCHEDULEINDEX_REMOVED_SLOT;
+   instance->removed++;
+}
+
+bool SortedScheduleIndex_Remove(SortedScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   uint32_t position = LowerBoundBetween(instance, 0, instance->count, time);
+
+   for(; (position < instance->count) && (instance->times[position] == time); position++)
+   {
+      if(instance->slots[position] == slot)
+      {
+         SortedScheduleIndex_RemoveAt(instance, position);
+         CompactIfSparse(instance);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+uint32_t SortedScheduleIndex_LowerBound(SortedScheduleIndex_t *instance, ScheduleTicks_t time)
+{
+   uint32_t position = instance->cursor;
+
+   if((position > instance->count) || ((position > 0) && (instance->times[position - 1] >= time)))
+   {
+      position = LowerBoundBetween(instance, 0, instance->count, time);
+   }
+   else
+   {
+      uint8_t steps = 0;
+
+      while((position < instance->count) && (instance->times[position] < time))
+      {
+         if(++steps > CursorWalkLimit)
+         {
+            position = LowerBoundBetween(instance, position, instance->count, time);
+            break;
+         }
+         position++;
+      }
+   }
+
+   instance->cursor = position;
+   return position;
+}
+
+uint32_t SortedScheduleIndex_CountDueAt(const SortedScheduleIndex_t *instance, uint32_t position, ScheduleTicks_t time)
+{
+   uint32_t end = position;
+
+   while(end < instance->count)
+   {
+      uint32_t block = instance->count - end;
+      if(block > SCHEDULETIMEMATCH_BLOCK_SIZE)
+      {
+         block = SCHEDULETIMEMATCH_BLOCK_SIZE;
+      }
+
+      // Due entries are contiguous, so the run ends at the first entry in the block that is not due
+      uint32_t notDue = ~ScheduleTimeMatch_DueMask(&instance->times[end], block, time);
+      uint32_t due = (notDue == 0) ? block : (uint32_t)__builtin_ctz(notDue);
+
+      end += due;
+      if(due < block)
+      {
+         break;
+      }
+   }
+
+   return end - position;
+}
+
+uint32_t SortedScheduleIndex_CollectDue(
+   SortedScheduleIndex_t *instance,
+   ScheduleTicks_t first,
+   ScheduleTicks_t last,
+   ScheduleSlot_t *slots)
+{
+   uassert(first <= last);
+
+   uint32_t start = SortedScheduleIndex_LowerBound(instance, first);
+   uint32_t end;
+
+   // Due entries are next to each other; a single tick is measured with the time matching kernels
+   if(first == last)
+   {
+      end = start + SortedScheduleIndex_CountDueAt(instance, start, first);
+   }
+   else if(last == SCHEDULETICKS_MAX)
+   {
+      end = instance->count;
+   }
+   else
+   {
+      end = SortedScheduleIndex_LowerBound(instance, last + 1);
+   }
+
+   uint32_t count = 0;
+   for(uint32_t position = start; position < end; position++)
+   {
+      if(instance->slots[position] != SORTEDSCHEDULEINDEX_REMOVED_SLOT)
+      {
+         slots[count++] = instance->slots[position];
+      }
+   }
+
+   return count;
+}
+
+// Passes over at most CursorWalkLimit removed entries; a longer run of them is compacted away, so
+// finding the next due time again does not pass over it every time
+static bool FirstNotRemovedFrom(SortedScheduleIndex_t *instance, uint32_t position, ScheduleTicks_t from, ScheduleTicks_t *time)
+{
+   uint8_t steps = 0;
+
+   while((position < instance->count) && (instance->slots[position] == SORTEDSCHEDULEINDEX_REMOVED_SLOT))
+   {
+      if(++steps > CursorWalkLimit)
+      {
+         Compact(instance);
+         position = LowerBoundBetween(instance, 0, instance->count, from);
+         break;
+      }
+      position++;
+   }
+
+   if(position < instance->count)
+   {
+      *time = instance->times[position];
+      return true;
+   }
+
+   return false;
+}
+
+bool SortedScheduleIndex_NextDue(SortedScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time)
+{
+   return FirstNotRemovedFrom(instance, SortedScheduleIndex_LowerBound(instance, from), from, time) ||
+      FirstNotRemovedFrom(instance, 0, 0, time);
+}
@@ -0,0 +1,135 @@
+/*!
+ * @file
+ * @brief Index of schedule slots kept in order of due time.  Lets the light scheduler find the
+ * schedules that are due at a tick without visiting every slot.
+ */
+
+#ifndef SORTEDSCHEDULEINDEX_H
+#define SORTEDSCHEDULEINDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "I_ScheduleIndex.h"
+
+/*!
+ * Slot of an entry that has been removed but not yet compacted out of the index.
+ */
+#define SORTEDSCHEDULEINDEX_REMOVED_SLOT ((ScheduleSlot_t)UINT32_MAX)
+
+/*!
+ * Entries are kept as two parallel arrays so that searching for due times only reads packed times.
+ * Removed entries keep their place with SORTEDSCHEDULEINDEX_REMOVED_SLOT as their slot until enough
+ * of them build up to be worth compacting, so removing does not shift the arrays every time.
+ */
+typedef struct
+{
+   I_ScheduleIndex_t interface;
+   ScheduleTicks_t *times;
+   ScheduleSlot_t *slots;
+   uint32_t count;
+   uint32_t removed;
+   uint32_t capacity;
+   uint32_t cursor;
+} SortedScheduleIndex_t;
+
+/*!
+ * Initialize an empty index.
+ * @param instance The index.
+ * @param times Storage for the time of each entry.
+ * @param slots Storage for the slot of each entry.
+ * @param capacity Number of entries that fit in the storage.
+ */
+void SortedScheduleIndex_Init(
+   SortedScheduleIndex_t *instance,
+   ScheduleTicks_t *times,
+   ScheduleSlot_t *slots,
+   uint32_t capacity);
+
+/*!
+ * Add a slot to the index.  Slots with the same time stay in the order they were inserted.  A slot
+ * due no earlier than every slot in the index is added in constant time.
+ * @pre The index holds fewer than capacity slots that have not been removed.
+ * @param instance The index.
+ * @param time The time the slot is due.
+ * @param slot The slot.
+ */
+void SortedScheduleIndex_Insert(SortedScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot);
+
+/*!
+ * Finds the time a slot is due, for SortedScheduleIndex_InsertMany.
+ */
+typedef ScheduleTicks_t (*SortedScheduleIndex_TimeOfSlot_t)(const void *context, ScheduleSlot_t slot);
+
+/*!
+ * Add many slots to the index at once, in one pass over the entries already in it instead of one
+ * pass per slot.  Slots with the same time stay in the order they were inserted, after any already
+ * in the index.  Takes O(n + m) for n slots and m entries already in the index.
+ * @pre The slots are in order of time.
+ * @pre The index has room for the slots once removed entries are compacted out of it.
+ * @param instance The index.
+ * @param slots The slots.
+ * @param count The number of slots.
+ * @param timeOf Finds the time each slot is due.
+ * @param context Passed to timeOf.
+ */
+void SortedScheduleIndex_InsertMany(
+   SortedScheduleIndex_t *instance,
+   const ScheduleSlot_t *slots,
+   uint32_t count,
+   SortedScheduleIndex_TimeOfSlot_t timeOf,
+   const void *context);
+
+/*!
+ * Remove the entry at a position.  The entry is marked as removed so that positions of the other
+ * entries do not change.
+ * @pre position < count
+ * @param instance The index.
+ * @param position The position of the entry to remove.
+ */
+void SortedScheduleIndex_RemoveAt(SortedScheduleIndex_t *instance, uint32_t position);
+
+/*!
+ * Remove a slot from the index.  Entry positions may change.
+ * @param instance The index.
+ * @param time The time the slot was inserted with.
+ * @param slot The slot.
+ * @return True if the slot was found and removed.
+ */
+bool SortedScheduleIndex_Remove(SortedScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot);
+
+/*!
+ * Find the position of the first entry that is due at or after a time.  Walks forward from the
+ * position found by the previous call when time moves forward, so finding the schedules for
+ * consecutive ticks costs time proportional to the number of schedules passed over.
+ * @param instance The index.
+ * @param time The time to search for.
+ * @return The position of the first entry with a time >= time, or count if there is none.
+ */
+uint32_t SortedScheduleIndex_LowerBound(SortedScheduleIndex_t *instance, ScheduleTicks_t time);
+
+/*!
+ * Count the consecutive entries due at a time, starting from a position.
+ * @param instance The index.
+ * @param position The position to start counting from.
+ * @param time The time the entries must be due at.
+ * @return The number of entries from position onwards with a time == time, including removed entries.
+ */
+uint32_t SortedScheduleIndex_CountDueAt(const SortedScheduleIndex_t *instance, uint32_t position, ScheduleTicks_t time);
+
+/*!
+ * Copy out the slots due from first through last.  Same contract as ScheduleIndex_CollectDue.
+ */
+uint32_t SortedScheduleIndex_CollectDue(
+   SortedScheduleIndex_t *instance,
+   ScheduleTicks_t first,
+   ScheduleTicks_t last,
+   ScheduleSlot_t *slots);
+
+/*!
+ * Find the next time a slot is due.  Same contract as ScheduleIndex_NextDue.  Takes O(log n), except
+ * that a run of more than a few removed entries in the way is compacted out first, in O(n); that
+ * takes more removals before it can happen again.
+ */
+bool SortedScheduleIndex_NextDue(SortedScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time);
+
+#endif
@@ -0,0 +1,265 @@
+/*!
+ * @file
+ * @brief Timing wheel schedule index implementation.
+ */
+
+#include "TimingWheelScheduleIndex.h"
+#include "uassert.h"
+
+static void SetOccupied(TimingWheelScheduleIndex_t *instance, uint32_t bucket, bool occupied)
+{
+   if(occupied)
+   {
+      instance->occupied[bucket / 32] |= (uint32_t)1 << (bucket % 32);
+   }
+   else
+   {
+      instance->occupied[bucket / 32] &= ~((uint32_t)1 << (bucket % 32));
+   }
+}
+
+// Number of buckets from bucket to the next occupied one, bucket included, or the number of buckets
+// if the wheel is empty
+static uint32_t DistanceToOccupied(const TimingWheelScheduleIndex_t *instance, uint32_t bucket)
+{
+   uint32_t words = TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(instance->bucketMask + 1);
+   uint32_t word = bucket / 32;
+   uint32_t bits = instance->occupied[word] & (UINT32_MAX << (bucket % 32));
+
+   // The starting word is looked at again last for the buckets before bucket
+   for(uint32_t visited = 0; visited <= words; visited++)
+   {
+      if(bits != 0)
+      {
+         uint32_t occupied = word * 32 + (uint32_t)__builtin_ctz(bits);
+         return (occupied - bucket) & instance->bucketMask;
+      }
+
+      word = (word + 1) % words;
+      bits = instance->occupied[word];
+   }
+
+   return instance->bucketMask + 1;
+}
+
+static void Insert(I_ScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   TimingWheelScheduleIndex_Insert((TimingWheelScheduleIndex_t *)instance, time, slot);
+}
+
+static bool Remove(I_ScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   return TimingWheelScheduleIndex_Remove((TimingWheelScheduleIndex_t *)instance, time, slot);
+}
+
+static uint32_t CollectDue(I_ScheduleIndex_t *instance, ScheduleTicks_t first, ScheduleTicks_t last, ScheduleSlot_t *slots)
+{
+   return TimingWheelScheduleIndex_CollectDue((TimingWheelScheduleIndex_t *)instance, first, last, slots);
+}
+
+static bool NextDue(I_ScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time)
+{
+   return TimingWheelScheduleIndex_NextDue((TimingWheelScheduleIndex_t *)instance, from, time);
+}
+
+static const I_ScheduleIndex_Api_t api = { Insert, Remove, CollectDue, NextDue };
+
+void TimingWheelScheduleIndex_Init(
+   TimingWheelScheduleIndex_t *instance,
+   ScheduleTicks_t *times,
+   ScheduleSlot_t *next,
+   ScheduleSlot_t *previous,
+   ScheduleSlot_t *heads,
+   uint32_t *occupied,
+   uint32_t capacity,
+   uint32_t buckets)
+{
+   uassert((buckets > 0) && ((buckets & (buckets - 1)) == 0));
+
+   instance->interface.api = &api;
+   instance->times = times;
+   instance->next = next;
+   instance->previous = previous;
+   instance->heads = heads;
+   instance->occupied = occupied;
+   instance->capacity = capacity;
+   instance->bucketMask = buckets - 1;
+
+   for(uint32_t slot = 0; slot < capacity; slot++)
+   {
+      previous[slot] = TIMINGWHEELSCHEDULEINDEX_NO_SLOT;
+   }
+
+   for(uint32_t bucket = 0; bucket < buckets; bucket++)
+   {
+      heads[bucket] = TIMINGWHEELSCHEDULEINDEX_NO_SLOT;
+   }
+
+   for(uint32_t word = 0; word < TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(buckets); word++)
+   {
+      occupied[word] = 0;
+   }
+}
+
+void TimingWheelScheduleIndex_Insert(TimingWheelScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   uassert(slot < instance->capacity);
+   uassert(instance->previous[slot] == TIMINGWHEELSCHEDULEINDEX_NO_SLOT);
+
+   uint32_t bucket = (uint32_t)(time & instance->bucketMask);
+   ScheduleSlot_t head = instance->heads[bucket];
+
+   instance->times[slot] = time;
+   instance->next[slot] = TIMINGWHEELSCHEDULEINDEX_NO_SLOT;
+
+   if(head == TIMINGWHEELSCHEDULEINDEX_NO_SLOT)
+   {
+      instance->heads[bucket] = slot;
+      instance->previous[slot] = slot;
+      SetOccupied(instance, bucket, true);
+   }
+   else
+   {
+      ScheduleSlot_t tail = instance->previous[head];
+      instance->next[tail] = slot;
+      instance->previous[slot] = tail;
+      instance->previous[head] = slot;
+   }
+}
+
+bool TimingWheelScheduleIndex_Remove(TimingWheelScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot)
+{
+   if((slot >= instance->capacity) ||
+      (instance->previous[slot] == TIMINGWHEELSCHEDULEINDEX_NO_SLOT) ||
+      (instance->times[slot] != time))
+   {
+      return false;
+   }
+
+   uint32_t bucket = (uint32_t)(time & instance->bucketMask);
+   ScheduleSlot_t head = instance->heads[bucket];
+   ScheduleSlot_t next = instance->next[slot];
+   ScheduleSlot_t previous = instance->previous[slot];
+
+   if(slot == head)
+   {
+      instance->heads[bucket] = next;
+      if(next == TIMINGWHEELSCHEDULEINDEX_NO_SLOT)
+      {
+         SetOccupied(instance, bucket, false);
+      }
+      else
+      {
+         instance->previous[next] = previous;
+      }
+   }
+   else
+   {
+      instance->next[previous] = next;
+      instance->previous[(next == TIMINGWHEELSCHEDULEINDEX_NO_SLOT) ? head : next] = previous;
+   }
+
+   instance->previous[slot] = TIMINGWHEELSCHEDULEINDEX_NO_SLOT;
+   return true;
+}
+
+uint32_t TimingWheelScheduleIndex_CollectDue(
+   TimingWheelScheduleIndex_t *instance,
+   ScheduleTicks_t first,
+   ScheduleTicks_t last,
+   ScheduleSlot_t *slots)
+{
+   uassert(first <= last);
+
+   uint32_t count = 0;
+   ScheduleTicks_t time = first;
+
+   while(true)
+   {
+      uint32_t skip = DistanceToOccupied(instance, (uint32_t)(time & instance->bucketMask));
+
+      if((skip > instance->bucketMask) || (skip > (ScheduleTicks_t)(last - time)))
+      {
+         break;
+      }
+      time += skip;
+
+      // A bucket holds every time with the same low bits, so only the slots due at this time are taken
+      ScheduleSlot_t slot = instance->heads[time & instance->bucketMask];
+      for(; slot != TIMINGWHEELSCHEDULEINDEX_NO_SLOT; slot = instance->next[slot])
+      {
+         if(instance->times[slot] == time)
+         {
+            slots[count++] = slot;
+         }
+      }
+
+      if(time == last)
+      {
+         break;
+      }
+      time++;
+   }
+
+   return count;
+}
+
+// Slots more than a turn of the wheel away share buckets with nearer times, so the nearest one can
+// only be found by looking at every slot
+static bool NearestSlotTime(const TimingWheelScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time)
+{
+   bool found = false;
+
+   for(uint32_t bucket = 0; bucket <= instance->bucketMask; bucket++)
+   {
+      ScheduleSlot_t slot = instance->heads[bucket];
+      for(; slot != TIMINGWHEELSCHEDULEINDEX_NO_SLOT; slot = instance->next[slot])
+      {
+         if(!found || ((ScheduleTicks_t)(instance->times[slot] - from) < (ScheduleTicks_t)(*time - from)))
+         {
+            *time = instance->times[slot];
+            found = true;
+         }
+      }
+   }
+
+   return found;
+}
+
+bool TimingWheelScheduleIndex_NextDue(TimingWheelScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time)
+{
+   ScheduleTicks_t candidate = from;
+   uint32_t travelled = 0;
+
+   while(true)
+   {
+      uint32_t skip = DistanceToOccupied(instance, (uint32_t)(candidate & instance->bucketMask));
+
+      if(skip > instance->bucketMask)
+      {
+         return false;
+      }
+
+      travelled += skip;
+      if(travelled > instance->bucketMask)
+      {
+         break;
+      }
+      candidate += skip;
+
+      ScheduleSlot_t slot = instance->heads[candidate & instance->bucketMask];
+      for(; slot != TIMINGWHEELSCHEDULEINDEX_NO_SLOT; slot = instance->next[slot])
+      {
+         if(instance->times[slot] == candidate)
+         {
+            *time = candidate;
+            return true;
+         }
+      }
+
+      candidate++;
+      travelled++;
+   }
+
+   return NearestSlotTime(instance, from, time);
+}
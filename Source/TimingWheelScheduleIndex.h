@@ -0,0 +1,101 @@
+/*!
+ * @file
+ * @brief Schedule index kept as a hashed timing wheel.  Each slot hangs off the bucket for the low
+ * bits of its time, so inserting and removing a slot take constant time however many slots there
+ * are, and collecting the due slots costs time proportional to the ticks covered and the slots in
+ * the buckets visited.
+ */
+
+#ifndef TIMINGWHEELSCHEDULEINDEX_H
+#define TIMINGWHEELSCHEDULEINDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "I_ScheduleIndex.h"
+
+/*!
+ * Link of the last slot in a bucket, and of a slot that is not in the wheel.
+ */
+#define TIMINGWHEELSCHEDULEINDEX_NO_SLOT ((ScheduleSlot_t)UINT32_MAX)
+
+/*!
+ * Number of 32-bit words in the bitmap of occupied buckets.
+ */
+#define TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(buckets) (((buckets) + 31) / 32)
+
+/*!
+ * Each bucket is a doubly linked list of slots threaded through next and previous, which are indexed
+ * by slot, so a slot can be unlinked without searching its bucket.  A bucket's first slot links back
+ * to its last one so that slots can be appended in insertion order.  occupied has a bit set for each
+ * bucket that is not empty, so that runs of empty buckets are skipped a word at a time.
+ */
+typedef struct
+{
+   I_ScheduleIndex_t interface;
+   ScheduleTicks_t *times;
+   ScheduleSlot_t *next;
+   ScheduleSlot_t *previous;
+   ScheduleSlot_t *heads;
+   uint32_t *occupied;
+   uint32_t capacity;
+   uint32_t bucketMask;
+} TimingWheelScheduleIndex_t;
+
+/*!
+ * Initialize an empty wheel.
+ * @pre buckets is a power of two
+ * @param instance The wheel.
+ * @param times Storage for the time of each slot, capacity entries.
+ * @param next Storage for the link to the next slot in a bucket, capacity entries.
+ * @param previous Storage for the link to the previous slot in a bucket, capacity entries.
+ * @param heads Storage for the first slot of each bucket, buckets entries.
+ * @param occupied Storage for TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(buckets) words.
+ * @param capacity Number of slots, i.e. slots must be less than capacity.
+ * @param buckets Number of buckets.
+ */
+void TimingWheelScheduleIndex_Init(
+   TimingWheelScheduleIndex_t *instance,
+   ScheduleTicks_t *times,
+   ScheduleSlot_t *next,
+   ScheduleSlot_t *previous,
+   ScheduleSlot_t *heads,
+   uint32_t *occupied,
+   uint32_t capacity,
+   uint32_t buckets);
+
+/*!
+ * Add a slot to the wheel.  Slots with the same time stay in the order they were inserted.
+ * @pre slot < capacity and the slot is not in the wheel.
+ * @param instance The wheel.
+ * @param time The time the slot is due.
+ * @param slot The slot.
+ */
+void TimingWheelScheduleIndex_Insert(TimingWheelScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot);
+
+/*!
+ * Remove a slot from the wheel.
+ * @param instance The wheel.
+ * @param time The time the slot was inserted with.
+ * @param slot The slot.
+ * @return True if the slot was found and removed.
+ */
+bool TimingWheelScheduleIndex_Remove(TimingWheelScheduleIndex_t *instance, ScheduleTicks_t time, ScheduleSlot_t slot);
+
+/*!
+ * Copy out the slots due from first through last.  Same contract as ScheduleIndex_CollectDue.  When
+ * the range covers more ticks than there are buckets, buckets are visited once per lap of the wheel.
+ */
+uint32_t TimingWheelScheduleIndex_CollectDue(
+   TimingWheelScheduleIndex_t *instance,
+   ScheduleTicks_t first,
+   ScheduleTicks_t last,
+   ScheduleSlot_t *slots);
+
+/*!
+ * Find the next time a slot is due.  Same contract as ScheduleIndex_NextDue.  Looks through the
+ * buckets one turn of the wheel ahead of from, and through every slot if none of them is due within
+ * that turn.
+ */
+bool TimingWheelScheduleIndex_NextDue(TimingWheelScheduleIndex_t *instance, ScheduleTicks_t from, ScheduleTicks_t *time);
+
+#endif
@@ -0,0 +1,20 @@
+/*!
+ * @file
+ * @brief Benchmark runner.
+ */
+
+#include "LightScheduler_Benchmark.h"
+#include "ScheduleLayout_Benchmark.h"
+#include "ScheduleIndex_Benchmark.h"
+#include "ScheduleTimeMatch_Benchmark.h"
+#include "ShardedLightScheduler_Benchmark.h"
+
+int main(void)
+{
+   LightScheduler_Benchmark_Run();
+   ScheduleLayout_Benchmark_Run();
+   ScheduleIndex_Benchmark_Run();
+   ScheduleTimeMatch_Benchmark_Run();
+   ShardedLightScheduler_Benchmark_Run();
+   return 0;
+}
@@ -0,0 +1,61 @@
+/*!
+ * @file
+ * @brief Helpers shared by the benchmarks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Benchmark.h"
+
+static TimeSourceTickCount_t GetTicks(I_TimeSource_t *instance)
+{
+   return ((Benchmark_TimeSource_t *)instance)->ticks;
+}
+
+static const I_TimeSource_Api_t timeSourceApi =
+   { GetTicks };
+
+static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   (void)channel;
+   (void)state;
+   ((Benchmark_DigitalOutputGroup_t *)instance)->writes++;
+}
+
+static const I_DigitalOutputGroup_Api_t digitalOutputGroupApi =
+   { Write, NULL };
+
+void Benchmark_TimeSource_Init(Benchmark_TimeSource_t *instance)
+{
+   instance->interface.api = &timeSourceApi;
+   instance->ticks = 0;
+}
+
+void Benchmark_DigitalOutputGroup_Init(Benchmark_DigitalOutputGroup_t *instance)
+{
+   instance->interface.api = &digitalOutputGroupApi;
+   instance->writes = 0;
+}
+
+uint64_t Benchmark_Nanoseconds(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+uint32_t Benchmark_Random(uint32_t *seed)
+{
+   *seed = *seed * 1664525u + 1013904223u;
+   return *seed >> 8;
+}
+
+void __uassert_func(const char *fileName, int lineNumber, bool condition, const char *conditionString)
+{
+   if(!condition)
+   {
+      fprintf(stderr, "%s:%d: assertion failed: %s\n", fileName, lineNumber, conditionString);
+      abort();
+   }
+}
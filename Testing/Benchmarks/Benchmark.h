@@ -0,0 +1,45 @@
+/*!
+ * @file
+ * @brief Helpers shared by the benchmarks.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include "I_DigitalOutputGroup.h"
+#include "I_TimeSource.h"
+
+typedef struct
+{
+   I_TimeSource_t interface;
+   TimeSourceTickCount_t ticks;
+} Benchmark_TimeSource_t;
+
+typedef struct
+{
+   I_DigitalOutputGroup_t interface;
+   uint32_t writes;
+} Benchmark_DigitalOutputGroup_t;
+
+/*!
+ * Initialize a time source whose ticks are set directly by the benchmark.
+ */
+void Benchmark_TimeSource_Init(Benchmark_TimeSource_t *instance);
+
+/*!
+ * Initialize a digital output group that only counts the writes it receives.
+ */
+void Benchmark_DigitalOutputGroup_Init(Benchmark_DigitalOutputGroup_t *instance);
+
+/*!
+ * Monotonic time in nanoseconds.
+ */
+uint64_t Benchmark_Nanoseconds(void);
+
+/*!
+ * Deterministic pseudo-random number so that every run measures the same data.
+ */
+uint32_t Benchmark_Random(uint32_t *seed);
+
+#endif
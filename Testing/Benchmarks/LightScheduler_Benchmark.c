@@ -0,0 +1,189 @@
+/*!
+ * @file
+ * @brief Benchmarks for the light scheduler.
+ */
+
+#include <stdio.h>
+#include "LightScheduler_Benchmark.h"
+#include "LightScheduler.h"
+#include "Benchmark.h"
+
+enum
+{
+   TicksPerPass = 65536,
+   MaxScheduleCount = 100000,
+   ChurnOperations = 100000
+};
+
+static LightSchedulerHandle_t handles[MaxScheduleCount];
+
+static LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(MaxScheduleCount)];
+static LightScheduler_t scheduler;
+static uint8_t snapshot[LIGHTSCHEDULER_SNAPSHOT_SIZE(MaxScheduleCount)];
+static Benchmark_TimeSource_t timeSource;
+static Benchmark_DigitalOutputGroup_t lights;
+
+static void FillScheduler(uint32_t scheduleCount)
+{
+   uint32_t seed = 1;
+
+   Benchmark_TimeSource_Init(&timeSource);
+   Benchmark_DigitalOutputGroup_Init(&lights);
+   LightScheduler_InitWithStorage(&scheduler, &lights.interface, &timeSource.interface, storage, scheduleCount);
+
+   for(uint32_t i = 0; i < scheduleCount; i++)
+   {
+      LightScheduler_AddSchedule(
+         &scheduler,
+         (uint8_t)Benchmark_Random(&seed),
+         Benchmark_Random(&seed) & 1,
+         (TimeSourceTickCount_t)Benchmark_Random(&seed));
+   }
+}
+
+// The scan that LightScheduler_Run used before schedules were indexed by time
+static void RunLinearScan(uint32_t scheduleCount)
+{
+   TimeSourceTickCount_t time = TimeSource_GetTicks(&timeSource.interface);
+
+   for(uint32_t i = 0; i < scheduleCount; i++)
+   {
+      if((time == scheduler.schedules[i].time) && ((scheduler.activeSlots[i / 32] >> (i % 32)) & 1))
+      {
+         DigitalOutputGroup_Write(&lights.interface, scheduler.schedules[i].lightId, scheduler.schedules[i].lightState);
+      }
+   }
+}
+
+static double NanosecondsPerRun(uint32_t scheduleCount, bool indexed)
+{
+   uint64_t start = Benchmark_Nanoseconds();
+
+   for(uint32_t tick = 0; tick < TicksPerPass; tick++)
+   {
+      timeSource.ticks = (TimeSourceTickCount_t)tick;
+
+      if(indexed)
+      {
+         LightScheduler_Run(&scheduler);
+      }
+      else
+      {
+         RunLinearScan(scheduleCount);
+      }
+   }
+
+   return (double)(Benchmark_Nanoseconds() - start) / TicksPerPass;
+}
+
+static void RunFillAndChurn(uint32_t scheduleCount)
+{
+   uint32_t seed = 1;
+   uint32_t full = 0;
+
+   Benchmark_TimeSource_Init(&timeSource);
+   Benchmark_DigitalOutputGroup_Init(&lights);
+   LightScheduler_InitWithStorage(&scheduler, &lights.interface, &timeSource.interface, storage, scheduleCount);
+
+   uint64_t start = Benchmark_Nanoseconds();
+   for(uint32_t i = 0; i < scheduleCount; i++)
+   {
+      handles[i] = LightScheduler_AddSchedule(&scheduler, (uint8_t)i, true, (TimeSourceTickCount_t)Benchmark_Random(&seed));
+   }
+   double fill = (double)(Benchmark_Nanoseconds() - start) / scheduleCount;
+
+   // Each operation replaces a random schedule, so the table stays full the whole time
+   start = Benchmark_Nanoseconds();
+   for(uint32_t i = 0; i < ChurnOperations; i++)
+   {
+      uint32_t victim = Benchmark_Random(&seed) % scheduleCount;
+
+      LightScheduler_RemoveScheduleByHandle(&scheduler, handles[victim]);
+      if(LightScheduler_TryAddSchedule(&scheduler, (uint8_t)i, true, (TimeSourceTickCount_t)Benchmark_Random(&seed), &handles[victim]) ==
+         LightSchedulerStatus_Full)
+      {
+         full++;
+      }
+   }
+   double churn = (double)(Benchmark_Nanoseconds() - start) / ChurnOperations;
+
+   printf("%10u %14.1f %18.1f %10u\n", scheduleCount, fill, churn, full);
+}
+
+// Replaying the adds is what rebuilding the schedules from the control plane costs
+static void MeasureRestore(uint32_t scheduleCount)
+{
+   uint64_t start = Benchmark_Nanoseconds();
+   FillScheduler(scheduleCount);
+   double replay = (double)(Benchmark_Nanoseconds() - start) / 1000000.0;
+
+   uint32_t snapshotSize;
+   start = Benchmark_Nanoseconds();
+   LightScheduler_Serialize(&scheduler, snapshot, sizeof(snapshot), &snapshotSize);
+   double serialize = (double)(Benchmark_Nanoseconds() - start) / 1000000.0;
+
+   LightScheduler_InitWithStorage(&scheduler, &lights.interface, &timeSource.interface, storage, scheduleCount);
+   start = Benchmark_Nanoseconds();
+   LightSchedulerSnapshotStatus_t status = LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize);
+   double restore = (double)(Benchmark_Nanoseconds() - start) / 1000000.0;
+
+   printf("%10u %14u %12.2f %14.2f %12.2f%s\n",
+      scheduleCount,
+      snapshotSize,
+      replay,
+      serialize,
+      restore,
+      (status == LightSchedulerSnapshotStatus_Ok) ? "" : " failed");
+}
+
+void LightScheduler_Benchmark_Run(void)
+{
+   static const uint32_t scheduleCounts[] = { 10, 100, 1000, 10000, 100000 };
+
+#ifdef LIGHTSCHEDULER_PACKED_SCHEDULES
+   const char *encoding = "packed";
+#else
+   const char *encoding = "aligned";
+#endif
+   printf("%u-bit ticks, %u-bit light IDs, %s schedules: %u bytes per Schedule_t, %.1f bytes of storage per schedule\n\n",
+      LIGHTSCHEDULER_TICK_BITS,
+      LIGHTSCHEDULER_LIGHT_ID_BITS,
+      encoding,
+      (unsigned)sizeof(Schedule_t),
+      (double)sizeof(storage) / MaxScheduleCount);
+
+   printf("LightScheduler_Run cost per tick over %u ticks\n", TicksPerPass);
+   printf("%10s %16s %16s %14s %14s\n", "schedules", "linear ns/run", "indexed ns/run", "linear writes", "indexed writes");
+
+   for(uint32_t i = 0; i < sizeof(scheduleCounts) / sizeof(scheduleCounts[0]); i++)
+   {
+      uint32_t scheduleCount = scheduleCounts[i];
+
+      FillScheduler(scheduleCount);
+      double linear = NanosecondsPerRun(scheduleCount, false);
+      uint32_t linearWrites = lights.writes;
+
+      // Run writes a light once per tick however many of its schedules are due, so it can write less
+      lights.writes = 0;
+      double indexed = NanosecondsPerRun(scheduleCount, true);
+
+      printf("%10u %16.1f %16.1f %14u %14u\n", scheduleCount, linear, indexed, linearWrites, lights.writes);
+   }
+
+   // The sorted index shifts entries on every out-of-order add; see the schedule index benchmark for the wheel
+   printf("\nFilling a table, then replacing random schedules in the full table (sorted index)\n");
+   printf("%10s %14s %18s %10s\n", "schedules", "fill ns/add", "churn ns/replace", "full");
+
+   for(uint32_t i = 0; i < sizeof(scheduleCounts) / sizeof(scheduleCounts[0]); i++)
+   {
+      RunFillAndChurn(scheduleCounts[i]);
+   }
+
+   printf("\nRebuilding random schedules by adding them again, compared to a snapshot\n");
+   printf("%10s %14s %12s %14s %12s\n", "schedules", "snapshot bytes", "replay ms", "serialize ms", "restore ms");
+
+   for(uint32_t i = 0; i < sizeof(scheduleCounts) / sizeof(scheduleCounts[0]); i++)
+   {
+      MeasureRestore(scheduleCounts[i]);
+   }
+}
@@ -0,0 +1,11 @@
+/*!
+ * @file
+ * @brief Benchmarks for the light scheduler.
+ */
+
+#ifndef LIGHTSCHEDULER_BENCHMARK_H
+#define LIGHTSCHEDULER_BENCHMARK_H
+
+void LightScheduler_Benchmark_Run(void);
+
+#endif
@@ -0,0 +1,198 @@
+/*!
+ * @file
+ * @brief Benchmark of the schedule indexes against a linear schedule table.
+ */
+
+#include <stdio.h>
+#include "ScheduleIndex_Benchmark.h"
+#include "LightScheduler.h"
+#include "Benchmark.h"
+
+enum
+{
+   MaxScheduleCount = 1000000,
+   MaxBuckets = 65536,
+   // Filling a sorted index costs a shift per insert, which takes minutes at the largest size
+   MaxSortedScheduleCount = 100000,
+   ChurnOperations = 100000,
+   IndexedTicks = 65536,
+   LinearTicks = 256
+};
+
+#define SORTED_STORAGE_LENGTH LIGHTSCHEDULER_STORAGE_LENGTH(MaxScheduleCount)
+#define WHEEL_STORAGE_LENGTH LIGHTSCHEDULER_TIMING_WHEEL_STORAGE_LENGTH(MaxScheduleCount, MaxBuckets)
+
+static LightSchedulerStorage_t storage[(SORTED_STORAGE_LENGTH > WHEEL_STORAGE_LENGTH) ? SORTED_STORAGE_LENGTH : WHEEL_STORAGE_LENGTH];
+static LightSchedulerHandle_t handles[MaxScheduleCount];
+static LightScheduler_t scheduler;
+static Benchmark_TimeSource_t timeSource;
+static Benchmark_DigitalOutputGroup_t lights;
+
+// The table LightScheduler used before it had an index: every run compares every schedule
+static Schedule_t linearTable[MaxScheduleCount];
+static uint32_t linearCount;
+
+static void LinearAdd(uint8_t lightId, bool lightState, ScheduleTicks_t time)
+{
+   linearTable[linearCount].lightId = lightId;
+   linearTable[linearCount].lightState = lightState;
+   linearTable[linearCount].time = time;
+   linearCount++;
+}
+
+// Moving the last schedule into the hole is the cheapest removal a table like this can have
+static void LinearRemove(uint32_t position)
+{
+   linearTable[position] = linearTable[--linearCount];
+}
+
+static void LinearRun(void)
+{
+   ScheduleTicks_t time = TimeSource_GetTicks(&timeSource.interface);
+
+   for(uint32_t i = 0; i < linearCount; i++)
+   {
+      if(linearTable[i].time == time)
+      {
+         DigitalOutputGroup_Write(&lights.interface, linearTable[i].lightId, linearTable[i].lightState);
+      }
+   }
+}
+
+static uint32_t BucketsFor(uint32_t scheduleCount)
+{
+   uint32_t buckets = 1;
+
+   while((buckets < scheduleCount) && (buckets < MaxBuckets))
+   {
+      buckets *= 2;
+   }
+
+   return buckets;
+}
+
+static void InitScheduler(const char *kind, uint32_t scheduleCount)
+{
+   Benchmark_TimeSource_Init(&timeSource);
+   Benchmark_DigitalOutputGroup_Init(&lights);
+   linearCount = 0;
+
+   if(kind[0] == 's')
+   {
+      LightScheduler_InitWithStorage(&scheduler, &lights.interface, &timeSource.interface, storage, scheduleCount);
+   }
+   else if(kind[0] == 'w')
+   {
+      LightScheduler_InitWithTimingWheel(&scheduler, &lights.interface, &timeSource.interface, storage, scheduleCount, BucketsFor(scheduleCount));
+   }
+}
+
+static void Measure(const char *kind, uint32_t scheduleCount)
+{
+   bool linear = (kind[0] == 'l');
+   uint32_t seed = 7;
+
+   InitScheduler(kind, scheduleCount);
+
+   uint64_t start = Benchmark_Nanoseconds();
+   for(uint32_t i = 0; i < scheduleCount; i++)
+   {
+      ScheduleTicks_t time = (ScheduleTicks_t)(uint16_t)Benchmark_Random(&seed);
+
+      if(linear)
+      {
+         LinearAdd((uint8_t)i, true, time);
+      }
+      else
+      {
+         handles[i] = LightScheduler_AddSchedule(&scheduler, (uint8_t)i, true, time);
+      }
+   }
+   double fill = (double)(Benchmark_Nanoseconds() - start) / scheduleCount;
+
+   start = Benchmark_Nanoseconds();
+   for(uint32_t i = 0; i < ChurnOperations; i++)
+   {
+      uint32_t victim = Benchmark_Random(&seed) % scheduleCount;
+      ScheduleTicks_t time = (ScheduleTicks_t)(uint16_t)Benchmark_Random(&seed);
+
+      if(linear)
+      {
+         LinearRemove(victim);
+         LinearAdd((uint8_t)i, true, time);
+      }
+      else
+      {
+         LightScheduler_RemoveScheduleByHandle(&scheduler, handles[victim]);
+         handles[victim] = LightScheduler_AddSchedule(&scheduler, (uint8_t)i, true, time);
+      }
+   }
+   double churn = (double)(Benchmark_Nanoseconds() - start) / ChurnOperations;
+
+   uint32_t ticks = linear ? LinearTicks : IndexedTicks;
+   start = Benchmark_Nanoseconds();
+   for(uint32_t tick = 0; tick < ticks; tick++)
+   {
+      timeSource.ticks = (TimeSourceTickCount_t)tick;
+
+      if(linear)
+      {
+         LinearRun();
+      }
+      else
+      {
+         LightScheduler_Run(&scheduler);
+      }
+   }
+   double run = (double)(Benchmark_Nanoseconds() - start) / ticks;
+
+   printf("%10u %8s %14.1f %18.1f %14.1f\n", scheduleCount, kind, fill, churn, run);
+}
+
+// Loads a table in random order, which LightScheduler_LoadSchedules has to sort
+static void MeasureLoad(const char *kind, uint32_t scheduleCount)
+{
+   uint32_t seed = 11;
+
+   InitScheduler("linear", 0);
+   for(uint32_t i = 0; i < scheduleCount; i++)
+   {
+      LinearAdd((uint8_t)i, true, (ScheduleTicks_t)(uint16_t)Benchmark_Random(&seed));
+   }
+
+   InitScheduler(kind, scheduleCount);
+   uint64_t start = Benchmark_Nanoseconds();
+   LightScheduler_LoadSchedules(&scheduler, linearTable, scheduleCount);
+   double load = (double)(Benchmark_Nanoseconds() - start) / scheduleCount;
+
+   printf("%10u %8s %22.1f\n", scheduleCount, kind, load);
+}
+
+void ScheduleIndex_Benchmark_Run(void)
+{
+   static const uint32_t scheduleCounts[] = { 1000, 10000, 100000, 1000000 };
+
+   printf("\nSchedule indexes against a linear table, times spread over 65536 ticks\n");
+   printf("%10s %8s %14s %18s %14s\n", "schedules", "index", "fill ns/add", "churn ns/replace", "run ns/tick");
+
+   for(uint32_t i = 0; i < sizeof(scheduleCounts) / sizeof(scheduleCounts[0]); i++)
+   {
+      uint32_t scheduleCount = scheduleCounts[i];
+
+      Measure("linear", scheduleCount);
+      if(scheduleCount <= MaxSortedScheduleCount)
+      {
+         Measure("sorted", scheduleCount);
+      }
+      Measure("wheel", scheduleCount);
+   }
+
+   printf("\nLoading a table of schedules in random order\n");
+   printf("%10s %8s %22s\n", "schedules", "index", "load ns/schedule");
+
+   for(uint32_t i = 0; i < sizeof(scheduleCounts) / sizeof(scheduleCounts[0]); i++)
+   {
+      MeasureLoad("sorted", scheduleCounts[i]);
+      MeasureLoad("wheel", scheduleCounts[i]);
+   }
+}
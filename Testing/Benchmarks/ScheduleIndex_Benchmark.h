@@ -0,0 +1,11 @@
+/*!
+ * @file
+ * @brief Benchmark of the schedule indexes against a linear schedule table.
+ */
+
+#ifndef SCHEDULEINDEX_BENCHMARK_H
+#define SCHEDULEINDEX_BENCHMARK_H
+
+void ScheduleIndex_Benchmark_Run(void);
+
+#endif
@@ -0,0 +1,202 @@
+/*!
+ * @file
+ * @brief Micro-benchmark of the array-of-structs and structure-of-arrays schedule layouts.  Measures
+ * only the due check, with no index and no output writes, for both a full scan and a binary search.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "ScheduleLayout_Benchmark.h"
+#include "Benchmark.h"
+
+enum
+{
+   MaxScheduleCount = 100000,
+   ScannedTicks = 1024,
+   SearchedTicks = 1000000
+};
+
+// The layout Schedule_t had before the active flags and times were split out
+typedef struct
+{
+   bool active;
+   uint8_t lightId;
+   bool lightState;
+   uint16_t time;
+} ArrayOfStructsSchedule_t;
+
+typedef struct
+{
+   uint16_t time;
+   uint32_t slot;
+} ArrayOfStructsIndexEntry_t;
+
+static ArrayOfStructsSchedule_t arrayOfStructs[MaxScheduleCount];
+static ArrayOfStructsIndexEntry_t arrayOfStructsIndex[MaxScheduleCount];
+
+static uint16_t times[MaxScheduleCount];
+static uint32_t activeSlots[(MaxScheduleCount + 31) / 32];
+static uint16_t sortedTimes[MaxScheduleCount];
+
+static volatile uint32_t sink;
+
+static void Fill(uint32_t count)
+{
+   uint32_t seed = 1;
+
+   for(uint32_t i = 0; i < count; i++)
+   {
+      uint16_t time = (uint16_t)Benchmark_Random(&seed);
+
+      arrayOfStructs[i].active = true;
+      arrayOfStructs[i].lightId = (uint8_t)i;
+      arrayOfStructs[i].lightState = true;
+      arrayOfStructs[i].time = time;
+
+      times[i] = time;
+      activeSlots[i / 32] |= (uint32_t)1 << (i % 32);
+   }
+
+   // Sorted by counting, since every time fits in 16 bits
+   static uint32_t starts[65537];
+   for(uint32_t t = 0; t <= 65536; t++)
+   {
+      starts[t] = 0;
+   }
+   for(uint32_t i = 0; i < count; i++)
+   {
+      starts[times[i] + 1]++;
+   }
+   for(uint32_t t = 1; t <= 65536; t++)
+   {
+      starts[t] += starts[t - 1];
+   }
+   for(uint32_t i = 0; i < count; i++)
+   {
+      uint32_t position = starts[times[i]]++;
+      sortedTimes[position] = times[i];
+      arrayOfStructsIndex[position].time = times[i];
+      arrayOfStructsIndex[position].slot = i;
+   }
+}
+
+static double ScanArrayOfStructs(uint32_t count)
+{
+   uint32_t due = 0;
+   uint64_t start = Benchmark_Nanoseconds();
+
+   for(uint32_t tick = 0; tick < ScannedTicks; tick++)
+   {
+      for(uint32_t i = 0; i < count; i++)
+      {
+         due += (arrayOfStructs[i].time == tick) && arrayOfStructs[i].active;
+      }
+   }
+
+   sink = due;
+   return (double)(Benchmark_Nanoseconds() - start) / ScannedTicks;
+}
+
+static double ScanStructureOfArrays(uint32_t count)
+{
+   uint32_t due = 0;
+   uint64_t start = Benchmark_Nanoseconds();
+
+   for(uint32_t tick = 0; tick < ScannedTicks; tick++)
+   {
+      for(uint32_t i = 0; i < count; i++)
+      {
+         if(times[i] == tick)
+         {
+            due += (activeSlots[i / 32] >> (i % 32)) & 1;
+         }
+      }
+   }
+
+   sink = due;
+   return (double)(Benchmark_Nanoseconds() - start) / ScannedTicks;
+}
+
+static double SearchArrayOfStructs(uint32_t count)
+{
+   uint32_t seed = 2;
+   uint32_t found = 0;
+   uint64_t start = Benchmark_Nanoseconds();
+
+   for(uint32_t i = 0; i < SearchedTicks; i++)
+   {
+      uint16_t tick = (uint16_t)Benchmark_Random(&seed);
+      uint32_t low = 0;
+      uint32_t high = count;
+
+      while(low < high)
+      {
+         uint32_t middle = low + (high - low) / 2;
+         if(arrayOfStructsIndex[middle].time < tick)
+         {
+            low = middle + 1;
+         }
+         else
+         {
+            high = middle;
+         }
+      }
+      found += low;
+   }
+
+   sink = found;
+   return (double)(Benchmark_Nanoseconds() - start) / SearchedTicks;
+}
+
+static double SearchStructureOfArrays(uint32_t count)
+{
+   uint32_t seed = 2;
+   uint32_t found = 0;
+   uint64_t start = Benchmark_Nanoseconds();
+
+   for(uint32_t i = 0; i < SearchedTicks; i++)
+   {
+      uint16_t tick = (uint16_t)Benchmark_Random(&seed);
+      uint32_t low = 0;
+      uint32_t high = count;
+
+      while(low < high)
+      {
+         uint32_t middle = low + (high - low) / 2;
+         if(sortedTimes[middle] < tick)
+         {
+            low = middle + 1;
+         }
+         else
+         {
+            high = middle;
+         }
+      }
+      found += low;
+   }
+
+   sink = found;
+   return (double)(Benchmark_Nanoseconds() - start) / SearchedTicks;
+}
+
+void ScheduleLayout_Benchmark_Run(void)
+{
+   static const uint32_t scheduleCounts[] = { 1000, 10000, 100000 };
+
+   printf("\nDue check cost per tick by schedule layout\n");
+   printf("%10s %14s %14s %16s %16s\n", "schedules", "AoS scan ns", "SoA scan ns", "AoS search ns", "SoA search ns");
+
+   for(uint32_t i = 0; i < sizeof(scheduleCounts) / sizeof(scheduleCounts[0]); i++)
+   {
+      uint32_t count = scheduleCounts[i];
+
+      Fill(count);
+      printf(
+         "%10u %14.1f %14.1f %16.1f %16.1f\n",
+         count,
+         ScanArrayOfStructs(count),
+         ScanStructureOfArrays(count),
+         SearchArrayOfStructs(count),
+         SearchStructureOfArrays(count));
+   }
+}
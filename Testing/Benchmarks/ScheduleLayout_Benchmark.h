@@ -0,0 +1,11 @@
+/*!
+ * @file
+ * @brief Micro-benchmark of the array-of-structs and structure-of-arrays schedule layouts.
+ */
+
+#ifndef SCHEDULELAYOUT_BENCHMARK_H
+#define SCHEDULELAYOUT_BENCHMARK_H
+
+void ScheduleLayout_Benchmark_Run(void);
+
+#endif
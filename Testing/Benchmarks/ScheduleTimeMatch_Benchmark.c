@@ -0,0 +1,55 @@
+/*!
+ * @file
+ * @brief Benchmark of the schedule time matching kernels.
+ */
+
+#include <stdio.h>
+#include "ScheduleTimeMatch_Benchmark.h"
+#include "ScheduleTimeMatch.h"
+#include "Benchmark.h"
+
+enum
+{
+   TimeCount = 65536,
+   Passes = 200
+};
+
+static ScheduleTicks_t times[TimeCount];
+static volatile uint32_t sink;
+
+static double NanosecondsPerTime(ScheduleTimeMatch_DueMask_t kernel)
+{
+   uint32_t due = 0;
+   uint64_t start = Benchmark_Nanoseconds();
+
+   for(uint32_t pass = 0; pass < Passes; pass++)
+   {
+      for(uint32_t i = 0; i < TimeCount; i += SCHEDULETIMEMATCH_BLOCK_SIZE)
+      {
+         due += (uint32_t)__builtin_popcount(kernel(&times[i], SCHEDULETIMEMATCH_BLOCK_SIZE, (ScheduleTicks_t)pass));
+      }
+   }
+
+   sink = due;
+   return (double)(Benchmark_Nanoseconds() - start) / ((double)TimeCount * Passes);
+}
+
+void ScheduleTimeMatch_Benchmark_Run(void)
+{
+   uint32_t seed = 3;
+
+   for(uint32_t i = 0; i < TimeCount; i++)
+   {
+      times[i] = (ScheduleTicks_t)Benchmark_Random(&seed);
+   }
+
+   printf("\nDue mask kernels, ns per compared time\n");
+   printf("%10s %8.3f\n", "scalar", NanosecondsPerTime(ScheduleTimeMatch_DueMaskScalar));
+#ifdef SCHEDULETIMEMATCH_X86_KERNELS
+   printf("%10s %8.3f\n", "sse2", NanosecondsPerTime(ScheduleTimeMatch_DueMaskSse2));
+   if(ScheduleTimeMatch_Avx2Supported())
+   {
+      printf("%10s %8.3f\n", "avx2", NanosecondsPerTime(ScheduleTimeMatch_DueMaskAvx2));
+   }
+#endif
+}
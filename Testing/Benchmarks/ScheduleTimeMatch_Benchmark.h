@@ -0,0 +1,11 @@
+/*!
+ * @file
+ * @brief Benchmark of the schedule time matching kernels.
+ */
+
+#ifndef SCHEDULETIMEMATCH_BENCHMARK_H
+#define SCHEDULETIMEMATCH_BENCHMARK_H
+
+void ScheduleTimeMatch_Benchmark_Run(void);
+
+#endif
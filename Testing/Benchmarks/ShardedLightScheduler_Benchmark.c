@@ -0,0 +1,157 @@
+/*!
+ * @file
+ * @brief Benchmark of the sharded light scheduler running its shards on separate threads.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ShardedLightScheduler_Benchmark.h"
+#include "ShardedLightScheduler.h"
+#include "Benchmark.h"
+
+enum
+{
+   MaxShardCount = 8,
+   ScheduleCount = 400000,
+   // Every schedule is due within this many ticks, so each tick has plenty of work to divide
+   ActiveTicks = 256,
+   CacheLineSize = 64
+};
+
+// Each shard's outputs are kept a cache line apart so that counting writes does not share lines
+typedef struct
+{
+   Benchmark_DigitalOutputGroup_t group;
+   uint8_t padding[CacheLineSize];
+} ShardLights_t;
+
+typedef struct
+{
+   uint8_t shard;
+   pthread_t thread;
+} Worker_t;
+
+static ShardedLightScheduler_t scheduler;
+static LightScheduler_t shards[MaxShardCount];
+static LightSchedulerStorage_t *storage[MaxShardCount];
+static ShardLights_t lights[MaxShardCount];
+static Benchmark_TimeSource_t timeSource;
+static Worker_t workers[MaxShardCount];
+static pthread_barrier_t tickStarted;
+static pthread_barrier_t tickFinished;
+
+static void PinToCpu(pthread_t thread, uint8_t shard)
+{
+   long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+   cpu_set_t cpus;
+
+   CPU_ZERO(&cpus);
+   CPU_SET(shard % (cpuCount > 0 ? cpuCount : 1), &cpus);
+   pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+}
+
+static void FillScheduler(uint8_t shardCount)
+{
+   uint32_t seed = 1;
+   // Lights are random, so every shard gets close to its share; the rest is room for the difference
+   uint32_t maxSchedules = ScheduleCount / shardCount + ScheduleCount / 16;
+
+   Benchmark_TimeSource_Init(&timeSource);
+   ShardedLightScheduler_Init(&scheduler, &timeSource.interface, shards, shardCount);
+
+   for(uint8_t shard = 0; shard < shardCount; shard++)
+   {
+      storage[shard] = calloc(LIGHTSCHEDULER_STORAGE_LENGTH(maxSchedules), sizeof(LightSchedulerStorage_t));
+      Benchmark_DigitalOutputGroup_Init(&lights[shard].group);
+      ShardedLightScheduler_InitShard(&scheduler, shard, &lights[shard].group.interface, storage[shard], maxSchedules);
+   }
+
+   for(uint32_t i = 0; i < ScheduleCount; i++)
+   {
+      ShardedLightScheduler_AddSchedule(
+         &scheduler,
+         (uint8_t)Benchmark_Random(&seed),
+         Benchmark_Random(&seed) & 1,
+         (ScheduleTicks_t)((uint64_t)i * ActiveTicks / ScheduleCount));
+   }
+}
+
+static void *RunWorker(void *context)
+{
+   Worker_t *worker = (Worker_t *)context;
+
+   for(uint32_t tick = 0; tick < ActiveTicks; tick++)
+   {
+      pthread_barrier_wait(&tickStarted);
+      ShardedLightScheduler_RunShard(&scheduler, worker->shard);
+      pthread_barrier_wait(&tickFinished);
+   }
+
+   return NULL;
+}
+
+// Shard 0 runs on the calling thread, which also starts each tick
+static void MeasureThreads(uint8_t shardCount)
+{
+   FillScheduler(shardCount);
+
+   pthread_barrier_init(&tickStarted, NULL, shardCount);
+   pthread_barrier_init(&tickFinished, NULL, shardCount);
+   PinToCpu(pthread_self(), 0);
+
+   for(uint8_t shard = 1; shard < shardCount; shard++)
+   {
+      workers[shard].shard = shard;
+      pthread_create(&workers[shard].thread, NULL, RunWorker, &workers[shard]);
+      PinToCpu(workers[shard].thread, shard);
+   }
+
+   uint64_t start = Benchmark_Nanoseconds();
+   for(uint32_t tick = 0; tick < ActiveTicks; tick++)
+   {
+      timeSource.ticks = (TimeSourceTickCount_t)tick;
+      ShardedLightScheduler_BeginTick(&scheduler);
+      pthread_barrier_wait(&tickStarted);
+      ShardedLightScheduler_RunShard(&scheduler, 0);
+      pthread_barrier_wait(&tickFinished);
+   }
+   uint64_t elapsed = Benchmark_Nanoseconds() - start;
+
+   uint32_t writes = 0;
+   for(uint8_t shard = 0; shard < shardCount; shard++)
+   {
+      if(shard > 0)
+      {
+         pthread_join(workers[shard].thread, NULL);
+      }
+      writes += lights[shard].group.writes;
+      free(storage[shard]);
+   }
+
+   pthread_barrier_destroy(&tickStarted);
+   pthread_barrier_destroy(&tickFinished);
+
+   printf("%8u %14.1f %22.1f %10u\n",
+      shardCount,
+      (double)elapsed / ActiveTicks,
+      (double)ScheduleCount * 1000.0 / (double)elapsed,
+      writes);
+}
+
+void ShardedLightScheduler_Benchmark_Run(void)
+{
+   printf("\nSharded light scheduler, one shard per thread: %u schedules due over %u ticks, %ld CPUs online\n",
+      ScheduleCount,
+      ActiveTicks,
+      sysconf(_SC_NPROCESSORS_ONLN));
+   printf("%8s %14s %22s %10s\n", "threads", "ns/tick", "million schedules/s", "writes");
+
+   for(uint8_t shardCount = 1; shardCount <= MaxShardCount; shardCount *= 2)
+   {
+      MeasureThreads(shardCount);
+   }
+}
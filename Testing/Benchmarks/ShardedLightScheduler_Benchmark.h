@@ -0,0 +1,11 @@
+/*!
+ * @file
+ * @brief Benchmark of the sharded light scheduler running its shards on separate threads.
+ */
+
+#ifndef SHARDEDLIGHTSCHEDULER_BENCHMARK_H
+#define SHARDEDLIGHTSCHEDULER_BENCHMARK_H
+
+void ShardedLightScheduler_Benchmark_Run(void);
+
+#endif
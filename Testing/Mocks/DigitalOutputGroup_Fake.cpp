@@ -0,0 +1,27 @@
+/*!
+ * @file
+ * @brief Implementation of a digital output group fake.
+ */
+
+#include "DigitalOutputGroup_Fake.h"
+
+static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   (void)channel;
+   (void)state;
+   __atomic_fetch_add(&((DigitalOutputGroup_Fake_t *)instance)->writes, 1, __ATOMIC_RELAXED);
+}
+
+static const I_DigitalOutputGroup_Api_t api =
+   { Write, NULL };
+
+void DigitalOutputGroup_Fake_Init(DigitalOutputGroup_Fake_t *instance)
+{
+   instance->interface.api = &api;
+   instance->writes = 0;
+}
+
+uint32_t DigitalOutputGroup_Fake_Writes(DigitalOutputGroup_Fake_t *instance)
+{
+   return __atomic_load_n(&instance->writes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,28 @@
+/*!
+ * @file
+ * @brief Digital output group fake that counts the writes made to it instead of checking them, for
+ * tests that write too often to set expectations.  Safe to write to from several threads at once.
+ */
+
+#ifndef DIGITALOUTPUTGROUP_FAKE_H
+#define DIGITALOUTPUTGROUP_FAKE_H
+
+#include "I_DigitalOutputGroup.h"
+
+typedef struct
+{
+   I_DigitalOutputGroup_t interface;
+   uint32_t writes;
+} DigitalOutputGroup_Fake_t;
+
+/*!
+ * Initialize a fake that only supports Write, with no writes counted.
+ */
+void DigitalOutputGroup_Fake_Init(DigitalOutputGroup_Fake_t *instance);
+
+/*!
+ * @return The number of writes made so far.
+ */
+uint32_t DigitalOutputGroup_Fake_Writes(DigitalOutputGroup_Fake_t *instance);
+
+#endif
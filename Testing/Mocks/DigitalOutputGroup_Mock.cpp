@@ -15,10 +15,31 @@ static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t
       .withParameter("state", state);
 }
 
+static void WriteMany(I_DigitalOutputGroup_t *instance, const DigitalOutputWrite_t *writes, const uint16_t count)
+{
+   mock()
+      .actualCall("WriteMany")
+      .onObject(instance)
+      .withParameter("count", count);
+
+   for(uint16_t i = 0; i < count; i++)
+   {
+      Write(instance, writes[i].channel, writes[i].state);
+   }
+}
+
 static const I_DigitalOutputGroup_Api_t api =
-   { Write };
+   { Write, NULL };
+
+static const I_DigitalOutputGroup_Api_t writeManyApi =
+   { Write, WriteMany };
 
 void DigitalOutputGroup_Mock_Init(DigitalOutputGroup_Mock_t *instance)
 {
    instance->interface.api = &api;
 }
+
+void DigitalOutputGroup_Mock_InitWithWriteMany(DigitalOutputGroup_Mock_t *instance)
+{
+   instance->interface.api = &writeManyApi;
+}
@@ -13,6 +13,15 @@ typedef struct
    I_DigitalOutputGroup_t interface;
 } DigitalOutputGroup_Mock_t;
 
+/*!
+ * Initialize a mock that only supports Write.
+ */
 void DigitalOutputGroup_Mock_Init(DigitalOutputGroup_Mock_t *instance);
 
+/*!
+ * Initialize a mock that also supports WriteMany.  A WriteMany call is reported as a "WriteMany" call
+ * with the count, followed by a "Write" call for each channel written.
+ */
+void DigitalOutputGroup_Mock_InitWithWriteMany(DigitalOutputGroup_Mock_t *instance);
+
 #endif
@@ -0,0 +1,25 @@
+/*!
+ * @file
+ * @brief Implementation of TimeSource_Fake.
+ */
+
+#include "TimeSource_Fake.h"
+
+static TimeSourceTickCount_t GetTicks(I_TimeSource_t *instance)
+{
+   return __atomic_load_n(&((TimeSource_Fake_t *)instance)->ticks, __ATOMIC_ACQUIRE);
+}
+
+static const I_TimeSource_Api_t api =
+   { GetTicks };
+
+void TimeSource_Fake_Init(TimeSource_Fake_t *instance)
+{
+   instance->interface.api = &api;
+   instance->ticks = 0;
+}
+
+void TimeSource_Fake_SetTicks(TimeSource_Fake_t *instance, TimeSourceTickCount_t ticks)
+{
+   __atomic_store_n(&instance->ticks, ticks, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,31 @@
+/*!
+ * @file
+ * @brief Time source fake whose ticks are set by the test.  Safe to read from one thread while the
+ * test sets the ticks on another.
+ */
+
+#ifndef TIMESOURCE_FAKE_H
+#define TIMESOURCE_FAKE_H
+
+extern "C"
+{
+#include "I_TimeSource.h"
+}
+
+typedef struct
+{
+   I_TimeSource_t interface;
+   TimeSourceTickCount_t ticks;
+} TimeSource_Fake_t;
+
+/*!
+ * Initialize a fake that returns tick 0 until its ticks are set.
+ */
+void TimeSource_Fake_Init(TimeSource_Fake_t *instance);
+
+/*!
+ * Set the ticks returned from now on.
+ */
+void TimeSource_Fake_SetTicks(TimeSource_Fake_t *instance, TimeSourceTickCount_t ticks);
+
+#endif
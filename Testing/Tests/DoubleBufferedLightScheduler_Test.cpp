@@ -0,0 +1,257 @@
+/*!
+ * @file
+ * @brief Tests for double-buffered light scheduler implementation.
+ */
+
+extern "C"
+{
+#include "DoubleBufferedLightScheduler.h"
+#include "LightSchedulerCommandQueue.h"
+}
+
+#include <pthread.h>
+#include <sched.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "DigitalOutputGroup_Fake.h"
+#include "DigitalOutputGroup_Mock.h"
+#include "TimeSource_Fake.h"
+#include "TimeSource_Mock.h"
+
+TEST_GROUP(DoubleBufferedLightScheduler)
+{
+   DoubleBufferedLightScheduler_t scheduler;
+   LightScheduler_t first;
+   LightScheduler_t second;
+
+   DigitalOutputGroup_Mock_t fakeDigitalOutputGroup;
+   TimeSource_Mock_t fakeTimeSource;
+
+   void setup()
+   {
+      DigitalOutputGroup_Mock_Init(&fakeDigitalOutputGroup);
+      TimeSource_Mock_Init(&fakeTimeSource);
+
+      LightScheduler_Init(&first, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
+      LightScheduler_Init(&second, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
+      DoubleBufferedLightScheduler_Init(&scheduler, &first, &second);
+   }
+
+   void LightShouldBeTurnedOn(LightSchedulerLightId_t which)
+   {
+      mock()
+          .expectOneCall("Write")
+          .onObject(&fakeDigitalOutputGroup)
+          .withParameter("channel", which)
+          .withParameter("state", true);
+   }
+
+   void NothingShouldHappen()
+   {
+   }
+
+   void WhenTheLightSchedulerIsRunAtTime(TimeSourceTickCount_t time)
+   {
+      mock()
+          .expectOneCall("GetTicks")
+          .onObject(&fakeTimeSource)
+          .andReturnValue(time);
+      DoubleBufferedLightScheduler_Run(&scheduler);
+   }
+
+   LightScheduler_t *GivenAPlanTurningOnALightAtTime(LightSchedulerLightId_t lightId, ScheduleTicks_t time)
+   {
+      LightScheduler_t *plan = DoubleBufferedLightScheduler_BeginPlan(&scheduler);
+      CHECK_TRUE(plan != NULL);
+      LightScheduler_AddSchedule(plan, lightId, true, time);
+      return plan;
+   }
+};
+
+TEST(DoubleBufferedLightScheduler, ShouldRunTheFirstLightSchedulerUntilAPlanIsPublished)
+{
+   LightScheduler_AddSchedule(&first, 1, true, 10);
+   GivenAPlanTurningOnALightAtTime(2, 10);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   POINTERS_EQUAL(&first, DoubleBufferedLightScheduler_Active(&scheduler));
+}
+
+TEST(DoubleBufferedLightScheduler, ShouldRunAPublishedPlanFromTheNextRun)
+{
+   LightScheduler_AddSchedule(&first, 1, true, 10);
+   DoubleBufferedLightScheduler_Publish(&scheduler, GivenAPlanTurningOnALightAtTime(2, 10));
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   POINTERS_EQUAL(&second, DoubleBufferedLightScheduler_Active(&scheduler));
+}
+
+TEST(DoubleBufferedLightScheduler, ShouldNotBeginAnotherPlanUntilThePublishedOneIsAdopted)
+{
+   DoubleBufferedLightScheduler_Publish(&scheduler, GivenAPlanTurningOnALightAtTime(2, 10));
+   CHECK_FALSE(DoubleBufferedLightScheduler_PlanAdopted(&scheduler));
+   POINTERS_EQUAL(NULL, DoubleBufferedLightScheduler_BeginPlan(&scheduler));
+
+   WhenTheLightSchedulerIsRunAtTime(5);
+   CHECK_TRUE(DoubleBufferedLightScheduler_PlanAdopted(&scheduler));
+   POINTERS_EQUAL(&first, DoubleBufferedLightScheduler_BeginPlan(&scheduler));
+}
+
+TEST(DoubleBufferedLightScheduler, ShouldBeginEachPlanWithoutTheSchedulesOfThePlanItReplaced)
+{
+   static const Schedule_t image[] = { { 3, true, 10 } };
+   LightScheduler_AddSchedule(&first, 1, true, 10);
+   LightScheduler_UseScheduleImage(&first, image, 1);
+   DoubleBufferedLightScheduler_Publish(&scheduler, GivenAPlanTurningOnALightAtTime(2, 30));
+   WhenTheLightSchedulerIsRunAtTime(5);
+
+   LightScheduler_t *plan = DoubleBufferedLightScheduler_BeginPlan(&scheduler);
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(plan));
+   DoubleBufferedLightScheduler_Publish(&scheduler, plan);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(10);
+}
+
+TEST(DoubleBufferedLightScheduler, ShouldCatchUpOnANewPlanFromTheLastRunOfTheOldOne)
+{
+   WhenTheLightSchedulerIsRunAtTime(10);
+   DoubleBufferedLightScheduler_Publish(&scheduler, GivenAPlanTurningOnALightAtTime(2, 12));
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(15);
+   CHECK_EQUAL(15, LightScheduler_CurrentTicks(DoubleBufferedLightScheduler_Active(&scheduler)));
+}
+
+TEST(DoubleBufferedLightScheduler, ShouldNotRewriteLightsTheOldPlanLeftInTheRightState)
+{
+   LightScheduler_EnableShadow(&first);
+   LightScheduler_AddSchedule(&first, 1, true, 10);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightScheduler_t *plan = GivenAPlanTurningOnALightAtTime(1, 20);
+   LightScheduler_AddSchedule(plan, 2, true, 20);
+   DoubleBufferedLightScheduler_Publish(&scheduler, plan);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(DoubleBufferedLightScheduler, ShouldKeepApplyingTheCommandQueueAfterAdoptingAPlan)
+{
+   LightSchedulerCommand_t commands[4];
+   LightSchedulerCommandQueue_t queue;
+   LightSchedulerCommandQueue_Init(&queue, commands, 4);
+   LightScheduler_UseCommandQueue(&first, &queue);
+
+   DoubleBufferedLightScheduler_Publish(&scheduler, GivenAPlanTurningOnALightAtTime(2, 10));
+   LightSchedulerCommandQueue_AddSchedule(&queue, 3, true, 10);
+
+   LightShouldBeTurnedOn(2);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   POINTERS_EQUAL(NULL, first.commandQueue);
+}
+
+enum
+{
+   StressPlans = 500,
+   StressSchedulesPerPlan = 8
+};
+
+typedef struct
+{
+   DoubleBufferedLightScheduler_t *scheduler;
+   bool done;
+} StressPlanner_t;
+
+// Plan p has StressSchedulesPerPlan schedules, all at time 1 + p
+static void *BuildPlans(void *context)
+{
+   StressPlanner_t *planner = (StressPlanner_t *)context;
+
+   for(uint32_t p = 0; p < StressPlans; p++)
+   {
+      LightScheduler_t *plan;
+      while((plan = DoubleBufferedLightScheduler_BeginPlan(planner->scheduler)) == NULL)
+      {
+         sched_yield();
+      }
+
+      for(uint8_t lightId = 0; lightId < StressSchedulesPerPlan; lightId++)
+      {
+         LightScheduler_AddSchedule(plan, lightId, true, (ScheduleTicks_t)(1 + p));
+      }
+      DoubleBufferedLightScheduler_Publish(planner->scheduler, plan);
+   }
+
+   __atomic_store_n(&planner->done, true, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+// Replaces the plan from one thread while another runs it
+TEST_GROUP(DoubleBufferedLightSchedulerStress)
+{
+   DoubleBufferedLightScheduler_t scheduler;
+   LightScheduler_t first;
+   LightScheduler_t second;
+   TimeSource_Fake_t timeSource;
+   DigitalOutputGroup_Fake_t lights;
+
+   void setup()
+   {
+      TimeSource_Fake_Init(&timeSource);
+      DigitalOutputGroup_Fake_Init(&lights);
+
+      LightScheduler_Init(&first, &lights.interface, &timeSource.interface);
+      LightScheduler_Init(&second, &lights.interface, &timeSource.interface);
+      DoubleBufferedLightScheduler_Init(&scheduler, &first, &second);
+   }
+};
+
+TEST(DoubleBufferedLightSchedulerStress, ShouldOnlyEverRunWholePlans)
+{
+   StressPlanner_t planner = { &scheduler, false };
+   pthread_t thread;
+   CHECK_EQUAL(0, pthread_create(&thread, NULL, BuildPlans, &planner));
+
+   // Keeps running until the planner has finished and its last plan has been adopted
+   bool done = false;
+   while(!done)
+   {
+      done = __atomic_load_n(&planner.done, __ATOMIC_ACQUIRE);
+      DoubleBufferedLightScheduler_Run(&scheduler);
+      sched_yield();
+
+      LightScheduler_t *active = DoubleBufferedLightScheduler_Active(&scheduler);
+      uint32_t count = LightScheduler_ScheduleCount(active);
+      CHECK(count == 0 || count == StressSchedulesPerPlan);
+
+      if(count > 0)
+      {
+         LightSchedulerLightIterator_t iterator;
+         Schedule_t schedule;
+         Schedule_t firstSchedule;
+
+         LightScheduler_IterateLight(active, 0, &iterator);
+         CHECK_TRUE(LightScheduler_NextForLight(&iterator, &firstSchedule, NULL));
+
+         for(LightSchedulerLightId_t lightId = 1; lightId < StressSchedulesPerPlan; lightId++)
+         {
+            LightScheduler_IterateLight(active, lightId, &iterator);
+            CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+            CHECK_EQUAL(firstSchedule.time, schedule.time);
+         }
+      }
+   }
+   pthread_join(thread, NULL);
+
+   LightSchedulerLightIterator_t iterator;
+   Schedule_t schedule;
+   LightScheduler_IterateLight(DoubleBufferedLightScheduler_Active(&scheduler), 0, &iterator);
+   CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+   CHECK_EQUAL(StressPlans, schedule.time);
+}
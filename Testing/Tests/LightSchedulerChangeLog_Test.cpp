@@ -0,0 +1,256 @@
+/*!
+ * @file
+ * @brief Tests for logging the changes made to a light scheduler's schedules.
+ */
+
+extern "C"
+{
+#include "LightScheduler.h"
+#include "I_LightSchedulerChangeLog.h"
+}
+
+#include <string.h>
+#include "CppUTest/TestHarness.h"
+#include "DigitalOutputGroup_Fake.h"
+#include "TimeSource_Fake.h"
+
+enum
+{
+   MaxChanges = 32
+};
+
+typedef struct
+{
+   I_LightSchedulerChangeLog_t interface;
+   LightSchedulerCommand_t changes[MaxChanges];
+   uint32_t count;
+} RecordingChangeLog_t;
+
+static void Append(I_LightSchedulerChangeLog_t *instance, const LightSchedulerCommand_t *change)
+{
+   RecordingChangeLog_t *log = (RecordingChangeLog_t *)instance;
+
+   if(log->count < MaxChanges)
+   {
+      log->changes[log->count++] = *change;
+   }
+}
+
+TEST_GROUP(LightSchedulerChangeLog)
+{
+   LightScheduler_t scheduler;
+   TimeSource_Fake_t timeSource;
+   DigitalOutputGroup_Fake_t lights;
+   RecordingChangeLog_t changeLog;
+
+   uint8_t snapshot[LIGHTSCHEDULER_SNAPSHOT_SIZE(MAX_SCHEDULES)];
+   uint32_t snapshotSize;
+
+   void setup()
+   {
+      static const I_LightSchedulerChangeLog_Api_t changeLogApi = { Append };
+
+      TimeSource_Fake_Init(&timeSource);
+      DigitalOutputGroup_Fake_Init(&lights);
+      changeLog.interface.api = &changeLogApi;
+      changeLog.count = 0;
+
+      LightScheduler_Init(&scheduler, &lights.interface, &timeSource.interface);
+   }
+
+   void GivenTheChangesAreLogged()
+   {
+      LightScheduler_UseChangeLog(&scheduler, &changeLog.interface);
+   }
+
+   void WhenTheLightSchedulerIsRunAtTime(TimeSourceTickCount_t time)
+   {
+      TimeSource_Fake_SetTicks(&timeSource, time);
+      LightScheduler_Run(&scheduler);
+   }
+
+   void ChangeShouldBe(
+      uint32_t index,
+      LightSchedulerCommandType_t type,
+      LightSchedulerLightId_t lightId,
+      bool lightState,
+      ScheduleTicks_t time,
+      ScheduleTicks_t period,
+      uint32_t count)
+   {
+      const LightSchedulerCommand_t *change = &changeLog.changes[index];
+      CHECK_EQUAL(type, change->type);
+      CHECK_EQUAL(lightId, change->lightId);
+      CHECK_EQUAL(lightState, change->lightState);
+      CHECK_EQUAL(time, change->time);
+      CHECK_EQUAL(period, change->period);
+      CHECK_EQUAL(count, change->count);
+   }
+
+   void Serialize(uint8_t *to, uint32_t *size)
+   {
+      CHECK_EQUAL(LightSchedulerSnapshotStatus_Ok, LightScheduler_Serialize(&scheduler, to, LIGHTSCHEDULER_SNAPSHOT_SIZE(MAX_SCHEDULES), size));
+   }
+};
+
+TEST(LightSchedulerChangeLog, ShouldLogAddedSchedules)
+{
+   GivenTheChangesAreLogged();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddRecurringSchedule(&scheduler, 2, false, 20, 5, 3);
+
+   CHECK_EQUAL(2, changeLog.count);
+   ChangeShouldBe(0, LightSchedulerCommandType_Add, 1, true, 10, 0, 0);
+   ChangeShouldBe(1, LightSchedulerCommandType_AddRecurring, 2, false, 20, 5, 3);
+}
+
+TEST(LightSchedulerChangeLog, ShouldLogEachScheduleInALoadedTable)
+{
+   const Schedule_t table[] = { { 1, true, 20 }, { 2, true, 10 } };
+
+   GivenTheChangesAreLogged();
+   LightScheduler_LoadSchedules(&scheduler, table, 2);
+
+   CHECK_EQUAL(2, changeLog.count);
+   ChangeShouldBe(0, LightSchedulerCommandType_Add, 2, true, 10, 0, 0);
+   ChangeShouldBe(1, LightSchedulerCommandType_Add, 1, true, 20, 0, 0);
+}
+
+TEST(LightSchedulerChangeLog, ShouldNotLogAScheduleThatDidNotFit)
+{
+   for(uint8_t i = 0; i < MAX_SCHEDULES; i++)
+   {
+      LightScheduler_AddSchedule(&scheduler, i, true, 10);
+   }
+
+   GivenTheChangesAreLogged();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 20);
+   CHECK_EQUAL(0, changeLog.count);
+}
+
+TEST(LightSchedulerChangeLog, ShouldOnlyLogRemovalsThatRemovedSomething)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+
+   GivenTheChangesAreLogged();
+   LightScheduler_RemoveSchedule(&scheduler, 1, false, 10);
+   LightScheduler_RemoveAllForLight(&scheduler, 3);
+   CHECK_EQUAL(0, changeLog.count);
+
+   LightScheduler_RemoveSchedule(&scheduler, 1, true, 10);
+   LightScheduler_RemoveAllForLight(&scheduler, 2);
+   CHECK_EQUAL(2, changeLog.count);
+   ChangeShouldBe(0, LightSchedulerCommandType_Remove, 1, true, 10, 0, 0);
+   ChangeShouldBe(1, LightSchedulerCommandType_RemoveAllForLight, 2, false, 0, 0, 0);
+}
+
+TEST(LightSchedulerChangeLog, ShouldLogRemovingAScheduleByItsHandleAsRemovingOneSchedule)
+{
+   LightSchedulerHandle_t handle = LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 5, 2);
+
+   GivenTheChangesAreLogged();
+   LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+   LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+
+   CHECK_EQUAL(1, changeLog.count);
+   ChangeShouldBe(0, LightSchedulerCommandType_RemoveOne, 1, true, 10, 5, 2);
+}
+
+TEST(LightSchedulerChangeLog, ShouldLogARecurringScheduleMovingOnWhenItRuns)
+{
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 5, 3);
+
+   GivenTheChangesAreLogged();
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   CHECK_EQUAL(2, changeLog.count);
+   ChangeShouldBe(0, LightSchedulerCommandType_RemoveOne, 1, true, 10, 5, 3);
+   ChangeShouldBe(1, LightSchedulerCommandType_AddRecurring, 1, true, 15, 5, 2);
+}
+
+TEST(LightSchedulerChangeLog, ShouldLogARecurringScheduleThatRanOutAsRemoved)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 5, 1);
+
+   GivenTheChangesAreLogged();
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   CHECK_EQUAL(1, changeLog.count);
+   ChangeShouldBe(0, LightSchedulerCommandType_RemoveOne, 1, true, 10, 5, 1);
+}
+
+TEST(LightSchedulerChangeLog, ShouldNotLogRestoringASnapshot)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   Serialize(snapshot, &snapshotSize);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+
+   GivenTheChangesAreLogged();
+   LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize);
+   CHECK_EQUAL(0, changeLog.count);
+}
+
+TEST(LightSchedulerChangeLog, ShouldStopLogging)
+{
+   GivenTheChangesAreLogged();
+   LightScheduler_UseChangeLog(&scheduler, NULL);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   CHECK_EQUAL(0, changeLog.count);
+}
+
+TEST(LightSchedulerChangeLog, ShouldRemoveOnlyTheScheduleThatMatchesEveryField)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 5, 2);
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 5, 3);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+
+   LightSchedulerCommand_t removeOne = { LightSchedulerCommandType_RemoveOne, true, 1, 10, 5, 3 };
+   LightScheduler_ApplyCommand(&scheduler, &removeOne);
+   CHECK_EQUAL(2, LightScheduler_ScheduleCount(&scheduler));
+
+   LightScheduler_ApplyCommand(&scheduler, &removeOne);
+   CHECK_EQUAL(2, LightScheduler_ScheduleCount(&scheduler));
+
+   LightSchedulerCommand_t removeOneTime = { LightSchedulerCommandType_RemoveOne, true, 1, 10, 0, 0 };
+   LightScheduler_ApplyCommand(&scheduler, &removeOneTime);
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightSchedulerChangeLog, ShouldGiveBackTheSameSchedulesWhenReplayedOverTheSnapshotItStartedFrom)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 30);
+   WhenTheLightSchedulerIsRunAtTime(5);
+   Serialize(snapshot, &snapshotSize);
+
+   GivenTheChangesAreLogged();
+   LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 3, true, 40);
+   LightScheduler_AddRecurringSchedule(&scheduler, 4, true, 8, 4, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightScheduler_AddRecurringSchedule(&scheduler, 5, false, 9, 3, 2);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 10);
+   LightScheduler_AddSchedule(&scheduler, 4, false, 16);
+   LightScheduler_RemoveSchedule(&scheduler, 2, false, 30);
+   WhenTheLightSchedulerIsRunAtTime(14);
+   LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+   LightScheduler_AddSchedule(&scheduler, 6, true, 50);
+
+   uint8_t expected[LIGHTSCHEDULER_SNAPSHOT_SIZE(MAX_SCHEDULES)];
+   uint32_t expectedSize;
+   Serialize(expected, &expectedSize);
+
+   LightScheduler_Init(&scheduler, &lights.interface, &timeSource.interface);
+   LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize);
+   for(uint32_t i = 0; i < changeLog.count; i++)
+   {
+      LightScheduler_ApplyCommand(&scheduler, &changeLog.changes[i]);
+   }
+
+   uint8_t replayed[LIGHTSCHEDULER_SNAPSHOT_SIZE(MAX_SCHEDULES)];
+   uint32_t replayedSize;
+   Serialize(replayed, &replayedSize);
+
+   CHECK_EQUAL(expectedSize, replayedSize);
+   MEMCMP_EQUAL(expected, replayed, expectedSize);
+}
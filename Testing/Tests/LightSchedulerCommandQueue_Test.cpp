@@ -0,0 +1,287 @@
+/*!
+ * @file
+ * @brief Tests for light scheduler command queue implementation.
+ */
+
+extern "C"
+{
+#include "LightSchedulerCommandQueue.h"
+}
+
+#include <pthread.h>
+#include <sched.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "DigitalOutputGroup_Fake.h"
+#include "DigitalOutputGroup_Mock.h"
+#include "TimeSource_Fake.h"
+#include "TimeSource_Mock.h"
+#include "uassert_test.h"
+
+enum
+{
+   QueueCapacity = 4
+};
+
+TEST_GROUP(LightSchedulerCommandQueue)
+{
+   LightSchedulerCommandQueue_t queue;
+   LightSchedulerCommand_t commands[QueueCapacity];
+   LightScheduler_t scheduler;
+
+   DigitalOutputGroup_Mock_t fakeDigitalOutputGroup;
+   TimeSource_Mock_t fakeTimeSource;
+
+   void setup()
+   {
+      LightSchedulerCommandQueue_Init(&queue, commands, QueueCapacity);
+
+      DigitalOutputGroup_Mock_Init(&fakeDigitalOutputGroup);
+      TimeSource_Mock_Init(&fakeTimeSource);
+      LightScheduler_Init(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
+   }
+
+   void GivenTheLightSchedulerUsesTheQueue()
+   {
+      LightScheduler_UseCommandQueue(&scheduler, &queue);
+   }
+
+   void LightShouldBeTurnedOn(LightSchedulerLightId_t which)
+   {
+      mock()
+          .expectOneCall("Write")
+          .onObject(&fakeDigitalOutputGroup)
+          .withParameter("channel", which)
+          .withParameter("state", true);
+   }
+
+   void WhenTheLightSchedulerIsRunAtTime(TimeSourceTickCount_t time)
+   {
+      mock()
+          .expectOneCall("GetTicks")
+          .onObject(&fakeTimeSource)
+          .andReturnValue(time);
+      LightScheduler_Run(&scheduler);
+   }
+};
+
+TEST(LightSchedulerCommandQueue, ShouldBeEmptyAfterInit)
+{
+   LightSchedulerCommand_t command;
+   CHECK_FALSE(LightSchedulerCommandQueue_Pop(&queue, &command));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldAssertWhenTheCapacityIsNotAPowerOfTwo)
+{
+   CHECK_ASSERTION_FAILED(LightSchedulerCommandQueue_Init(&queue, commands, 3));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldPopCommandsInTheOrderTheyWerePushed)
+{
+   LightSchedulerCommandQueue_AddSchedule(&queue, 1, true, 10);
+   LightSchedulerCommandQueue_RemoveSchedule(&queue, 2, false, 20);
+
+   LightSchedulerCommand_t command;
+   CHECK_TRUE(LightSchedulerCommandQueue_Pop(&queue, &command));
+   CHECK_EQUAL(LightSchedulerCommandType_Add, command.type);
+   CHECK_EQUAL(1, command.lightId);
+   CHECK_TRUE(command.lightState);
+   CHECK_EQUAL(10, command.time);
+
+   CHECK_TRUE(LightSchedulerCommandQueue_Pop(&queue, &command));
+   CHECK_EQUAL(LightSchedulerCommandType_Remove, command.type);
+   CHECK_EQUAL(2, command.lightId);
+   CHECK_FALSE(command.lightState);
+   CHECK_EQUAL(20, command.time);
+
+   CHECK_FALSE(LightSchedulerCommandQueue_Pop(&queue, &command));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldRefuseACommandWhenFull)
+{
+   for(uint8_t i = 0; i < QueueCapacity; i++)
+   {
+      CHECK_TRUE(LightSchedulerCommandQueue_AddSchedule(&queue, i, true, 10));
+   }
+   CHECK_FALSE(LightSchedulerCommandQueue_AddSchedule(&queue, 9, true, 10));
+
+   LightSchedulerCommand_t command;
+   LightSchedulerCommandQueue_Pop(&queue, &command);
+   CHECK_TRUE(LightSchedulerCommandQueue_AddSchedule(&queue, 9, true, 10));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldKeepCommandsInOrderAsTheRingWrapsAround)
+{
+   LightSchedulerCommand_t command;
+
+   for(uint8_t i = 0; i < 3 * QueueCapacity; i++)
+   {
+      LightSchedulerCommandQueue_AddSchedule(&queue, i, true, 10);
+      LightSchedulerCommandQueue_AddSchedule(&queue, (uint8_t)(i + 100), true, 10);
+
+      CHECK_TRUE(LightSchedulerCommandQueue_Pop(&queue, &command));
+      CHECK_EQUAL(i, command.lightId);
+      CHECK_TRUE(LightSchedulerCommandQueue_Pop(&queue, &command));
+      CHECK_EQUAL(i + 100, command.lightId);
+   }
+}
+
+TEST(LightSchedulerCommandQueue, ShouldAssertWhenARecurringScheduleHasNoPeriod)
+{
+   CHECK_ASSERTION_FAILED(LightSchedulerCommandQueue_AddRecurringSchedule(&queue, 1, true, 10, 0, 2));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldApplyQueuedSchedulesAtTheStartOfARun)
+{
+   GivenTheLightSchedulerUsesTheQueue();
+   LightSchedulerCommandQueue_AddSchedule(&queue, 1, true, 10);
+   LightSchedulerCommandQueue_AddSchedule(&queue, 2, true, 20);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   CHECK_EQUAL(2, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldApplyQueuedRemovals)
+{
+   GivenTheLightSchedulerUsesTheQueue();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 20);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 10);
+   LightSchedulerCommandQueue_RemoveSchedule(&queue, 1, true, 10);
+   LightSchedulerCommandQueue_RemoveAllForLight(&queue, 2);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldApplyQueuedRecurringSchedules)
+{
+   GivenTheLightSchedulerUsesTheQueue();
+   LightSchedulerCommandQueue_AddRecurringSchedule(&queue, 1, true, 10, 5, 2);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(15);
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldNotApplyCommandsWhenTheQueueIsNotUsed)
+{
+   LightSchedulerCommandQueue_AddSchedule(&queue, 1, true, 10);
+
+   WhenTheLightSchedulerIsRunAtTime(10);
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightSchedulerCommandQueue, ShouldApplyAtMostAQueueOfCommandsPerRun)
+{
+   GivenTheLightSchedulerUsesTheQueue();
+   for(uint8_t i = 0; i < QueueCapacity; i++)
+   {
+      LightSchedulerCommandQueue_AddSchedule(&queue, i, true, 50);
+   }
+
+   WhenTheLightSchedulerIsRunAtTime(10);
+   CHECK_EQUAL(QueueCapacity, LightScheduler_ScheduleCount(&scheduler));
+}
+
+enum
+{
+   StressSchedules = 3000,
+   StressLights = 200,
+   StressQueueCapacity = 64
+};
+
+typedef struct
+{
+   LightSchedulerCommandQueue_t *queue;
+   bool done;
+} StressProducer_t;
+
+static void PushUntilQueued(LightSchedulerCommandQueue_t *queue, const LightSchedulerCommand_t *command)
+{
+   while(!LightSchedulerCommandQueue_Push(queue, command))
+   {
+      sched_yield();
+   }
+}
+
+// Adds a schedule at time 1 + i for every i, then removes the ones for odd i
+static void *Produce(void *context)
+{
+   StressProducer_t *producer = (StressProducer_t *)context;
+
+   for(uint32_t i = 0; i < StressSchedules; i++)
+   {
+      LightSchedulerCommand_t command = { LightSchedulerCommandType_Add, true, (LightSchedulerLightId_t)(i % StressLights), (ScheduleTicks_t)(1 + i), 0, 0 };
+      PushUntilQueued(producer->queue, &command);
+   }
+
+   for(uint32_t i = 1; i < StressSchedules; i += 2)
+   {
+      LightSchedulerCommand_t command = { LightSchedulerCommandType_Remove, true, (LightSchedulerLightId_t)(i % StressLights), (ScheduleTicks_t)(1 + i), 0, 0 };
+      PushUntilQueued(producer->queue, &command);
+   }
+
+   __atomic_store_n(&producer->done, true, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+static LightSchedulerStorage_t stressStorage[LIGHTSCHEDULER_STORAGE_LENGTH(StressSchedules)];
+
+// Runs the light scheduler on one thread while another changes its schedules through the queue
+TEST_GROUP(LightSchedulerCommandQueueStress)
+{
+   LightSchedulerCommand_t commands[StressQueueCapacity];
+   LightSchedulerCommandQueue_t queue;
+   LightScheduler_t scheduler;
+   TimeSource_Fake_t timeSource;
+   DigitalOutputGroup_Fake_t lights;
+
+   void setup()
+   {
+      TimeSource_Fake_Init(&timeSource);
+      DigitalOutputGroup_Fake_Init(&lights);
+
+      LightSchedulerCommandQueue_Init(&queue, commands, StressQueueCapacity);
+      LightScheduler_InitWithStorage(&scheduler, &lights.interface, &timeSource.interface, stressStorage, StressSchedules);
+      LightScheduler_UseCommandQueue(&scheduler, &queue);
+   }
+};
+
+TEST(LightSchedulerCommandQueueStress, ShouldNotLoseAnyUpdateMadeFromAnotherThread)
+{
+   StressProducer_t producer = { &queue, false };
+   pthread_t thread;
+   CHECK_EQUAL(0, pthread_create(&thread, NULL, Produce, &producer));
+
+   // Keeps running until the producer has finished and everything it queued has been applied
+   bool done = false;
+   while(!done)
+   {
+      done = __atomic_load_n(&producer.done, __ATOMIC_ACQUIRE);
+      LightScheduler_Run(&scheduler);
+   }
+   pthread_join(thread, NULL);
+
+   CHECK_EQUAL(StressSchedules / 2, LightScheduler_ScheduleCount(&scheduler));
+   CHECK_EQUAL(0, DigitalOutputGroup_Fake_Writes(&lights));
+
+   for(LightSchedulerLightId_t lightId = 0; lightId < StressLights; lightId++)
+   {
+      LightSchedulerLightIterator_t iterator;
+      Schedule_t schedule;
+      LightScheduler_IterateLight(&scheduler, lightId, &iterator);
+
+      while(LightScheduler_NextForLight(&iterator, &schedule, NULL))
+      {
+         CHECK_EQUAL(1, schedule.time % 2);
+         CHECK_EQUAL(lightId, (schedule.time - 1) % StressLights);
+      }
+   }
+}
@@ -6,6 +6,7 @@
 extern "C"
 {
 #include "LightScheduler.h"
+#include "LightSchedulerCommand.h"
 }
 
 #include "CppUTest/TestHarness.h"
@@ -29,7 +30,7 @@ TEST_GROUP(LightScheduler)
       LightScheduler_Init(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
    }
 
-   void LightShouldBeTurnedOn(uint8_t which)
+   void LightShouldBeTurnedOn(LightSchedulerLightId_t which)
    {
       mock()
           .expectOneCall("Write")
@@ -38,7 +39,7 @@ TEST_GROUP(LightScheduler)
           .withParameter("state", true);
    }
 
-   void LightShouldBeTurnedOff(uint8_t which)
+   void LightShouldBeTurnedOff(LightSchedulerLightId_t which)
    {
       mock()
           .expectOneCall("Write")
@@ -47,6 +48,26 @@ TEST_GROUP(LightScheduler)
           .withParameter("state", false);
    }
 
+   void GivenTheSchedulesAreKeptInATimingWheel()
+   {
+      enum { Capacity = 16, Buckets = 8 };
+      static LightSchedulerStorage_t storage[LIGHTSCHEDULER_TIMING_WHEEL_STORAGE_LENGTH(Capacity, Buckets)];
+      LightScheduler_InitWithTimingWheel(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity, Buckets);
+   }
+
+   void GivenTheLightsCanWriteManyChannelsAtOnce()
+   {
+      DigitalOutputGroup_Mock_InitWithWriteMany(&fakeDigitalOutputGroup);
+   }
+
+   void LightsShouldBeWrittenTogether(uint16_t count)
+   {
+      mock()
+          .expectOneCall("WriteMany")
+          .onObject(&fakeDigitalOutputGroup)
+          .withParameter("count", count);
+   }
+
    void WhenTheTimeIs(TimeSourceTickCount_t time)
    {
       mock()
@@ -59,9 +80,9 @@ TEST_GROUP(LightScheduler)
    {
    }
 
-   void WhenTheLightSchedulerIsRunAtTime(TimeSourceTickCount_t time)
+   void WhenTheLightSchedulerIsRunAtTime(ScheduleTicks_t time)
    {
-      WhenTheTimeIs(time);
+      WhenTheTimeIs((TimeSourceTickCount_t)time);
       LightScheduler_Run(&scheduler);
    }
 
@@ -70,6 +91,20 @@ TEST_GROUP(LightScheduler)
       WhenTheTimeIs(0);
       LightScheduler_Run(&scheduler);
    }
+
+   void GivenTheSchedulesHaveBeenSerialized()
+   {
+      CHECK_EQUAL(LightSchedulerSnapshotStatus_Ok, LightScheduler_Serialize(&scheduler, snapshot, sizeof(snapshot), &snapshotSize));
+   }
+
+   void WhenTheLightSchedulerIsRestartedFromTheSnapshot()
+   {
+      LightScheduler_Init(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
+      CHECK_EQUAL(LightSchedulerSnapshotStatus_Ok, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize));
+   }
+
+   uint8_t snapshot[LIGHTSCHEDULER_SNAPSHOT_SIZE(MAX_SCHEDULES)];
+   uint32_t snapshotSize;
 };
 
 TEST(LightScheduler, ShouldNotDoAnythingIfWeDontSetAnySchedules)
@@ -255,3 +290,1791 @@ TEST(LightScheduler, ShouldNotRunMoreThanMaxSchedules) {
 }
 
 
+TEST(LightScheduler, ShouldRunSchedulesThatWereAddedOutOfTimeOrder)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 20);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 15);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(15);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldOnlyRemoveTheMatchingScheduleAmongSchedulesAtTheSameTime)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 13);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+
+   LightScheduler_RemoveSchedule(&scheduler, 2, true, 13);
+
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOff(2);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+#if LIGHTSCHEDULER_TICK_BITS == 16
+
+TEST(LightScheduler, ShouldRunSchedulesAgainWhenTimeComesBackAround)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   WhenTheLightSchedulerIsRunAtTime(400);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+#endif
+
+TEST(LightScheduler, ShouldRunMoreThanMaxSchedulesWhenGivenLargerStorage)
+{
+   enum { Capacity = 300 };
+   static LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(Capacity)];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity);
+
+   for(uint16_t i = 0; i < Capacity + 1; i++)
+   {
+      LightScheduler_AddSchedule(&scheduler, (uint8_t)i, true, (TimeSourceTickCount_t)i);
+   }
+
+   for(uint16_t i = 0; i < Capacity; i++)
+   {
+      LightShouldBeTurnedOn((uint8_t)i);
+      WhenTheLightSchedulerIsRunAtTime(i);
+   }
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(Capacity);
+}
+
+TEST(LightScheduler, ShouldNotRunMoreSchedulesThanFitInTheGivenStorage)
+{
+   enum { Capacity = 2 };
+   LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(Capacity)];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity);
+
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldReuseASlotInTheGivenStorageAfterItIsRemoved)
+{
+   enum { Capacity = 1 };
+   LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(Capacity)];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity);
+
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+   LightScheduler_RemoveSchedule(&scheduler, 1, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 13);
+
+   LightShouldBeTurnedOff(2);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldRunAllSchedulesDueAtATimeWhenThereAreMoreThanABlockOfThem)
+{
+   enum { Capacity = 70 };
+   static LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(Capacity)];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity);
+
+   LightScheduler_AddSchedule(&scheduler, 200, true, 12);
+   for(uint8_t light = 0; light < Capacity - 2; light++)
+   {
+      LightScheduler_AddSchedule(&scheduler, light, true, 13);
+   }
+   LightScheduler_AddSchedule(&scheduler, 201, true, 14);
+
+   for(uint8_t light = 0; light < Capacity - 2; light++)
+   {
+      LightShouldBeTurnedOn(light);
+   }
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldRemoveOnlyTheScheduleAHandleRefersTo)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+
+   CHECK_TRUE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+TEST(LightScheduler, ShouldDetectAStaleHandle)
+{
+   LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   CHECK_TRUE(LightScheduler_ScheduleExists(&scheduler, handle));
+
+   LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+
+   CHECK_FALSE(LightScheduler_ScheduleExists(&scheduler, handle));
+   CHECK_FALSE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+}
+
+TEST(LightScheduler, ShouldNotRemoveTheScheduleThatReusedTheSlotOfAStaleHandle)
+{
+   LightSchedulerHandle_t stale = LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_RemoveSchedule(&scheduler, 3, true, 12);
+   LightSchedulerHandle_t current = LightScheduler_AddSchedule(&scheduler, 4, true, 12);
+
+   CHECK_EQUAL(stale.slot, current.slot);
+   CHECK_FALSE(LightScheduler_RemoveScheduleByHandle(&scheduler, stale));
+
+   LightShouldBeTurnedOn(4);
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+TEST(LightScheduler, ShouldReturnAHandleThatRefersToNothingWhenThereIsNoRoom)
+{
+   for(uint8_t light = 0; light < MAX_SCHEDULES; light++)
+   {
+      LightScheduler_AddSchedule(&scheduler, light, true, 12);
+   }
+
+   LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 11, true, 12);
+
+   CHECK_EQUAL(0, handle.generation);
+   CHECK_FALSE(LightScheduler_ScheduleExists(&scheduler, handle));
+   CHECK_FALSE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+}
+
+TEST(LightScheduler, ShouldNotAcceptAHandleForASlotOutsideTheTable)
+{
+   LightSchedulerHandle_t handle = { MAX_SCHEDULES, 1 };
+
+   CHECK_FALSE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+}
+
+TEST(LightScheduler, ShouldKeepRunningSchedulesAfterManyRemovalsByHandle)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 12);
+
+   for(uint16_t i = 0; i < 100; i++)
+   {
+      LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 2, true, (TimeSourceTickCount_t)(i % 3 + 11));
+      LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+   }
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+TEST(LightScheduler, ShouldReportWhenThereIsNoRoomForASchedule)
+{
+   LightSchedulerHandle_t handle;
+
+   for(uint8_t light = 0; light < MAX_SCHEDULES; light++)
+   {
+      CHECK_EQUAL(LightSchedulerStatus_Ok, LightScheduler_TryAddSchedule(&scheduler, light, true, 12, &handle));
+   }
+
+   CHECK_EQUAL(LightSchedulerStatus_Full, LightScheduler_TryAddSchedule(&scheduler, 11, true, 12, &handle));
+}
+
+TEST(LightScheduler, ShouldHaveRoomForAScheduleAgainAfterOneIsRemoved)
+{
+   for(uint8_t light = 0; light < MAX_SCHEDULES; light++)
+   {
+      LightScheduler_AddSchedule(&scheduler, light, true, 12);
+   }
+   LightScheduler_RemoveSchedule(&scheduler, 4, true, 12);
+
+   CHECK_EQUAL(LightSchedulerStatus_Ok, LightScheduler_TryAddSchedule(&scheduler, 11, true, 12, NULL));
+   CHECK_EQUAL(LightSchedulerStatus_Full, LightScheduler_TryAddSchedule(&scheduler, 12, true, 12, NULL));
+}
+
+TEST(LightScheduler, ShouldCountTheSchedulesThatAreScheduled)
+{
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+
+   LightScheduler_AddSchedule(&scheduler, 1, true, 12);
+   LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 2, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+   CHECK_EQUAL(3, LightScheduler_ScheduleCount(&scheduler));
+
+   LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+   LightScheduler_RemoveSchedule(&scheduler, 3, true, 13);
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldReportNoRoomWhenGivenStorageForNoSchedules)
+{
+   LightSchedulerStorage_t storage[1];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, 0);
+
+   CHECK_EQUAL(LightSchedulerStatus_Full, LightScheduler_TryAddSchedule(&scheduler, 1, true, 12, NULL));
+}
+
+TEST(LightScheduler, ShouldWriteAllDueLightsInOneCallWhenTheLightsCanWriteManyChannelsAtOnce)
+{
+   GivenTheLightsCanWriteManyChannelsAtOnce();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 13);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 4, true, 14);
+
+   LightsShouldBeWrittenTogether(3);
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOff(2);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldNotWriteManyChannelsWhenNoLightsAreDue)
+{
+   GivenTheLightsCanWriteManyChannelsAtOnce();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+TEST(LightScheduler, ShouldSplitWritesIntoBatchesWhenMoreLightsAreDueThanFitInABatch)
+{
+   enum { Capacity = LIGHTSCHEDULER_WRITE_BATCH_SIZE + 1 };
+   LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(Capacity)];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity);
+   GivenTheLightsCanWriteManyChannelsAtOnce();
+
+   for(uint8_t light = 0; light < Capacity; light++)
+   {
+      LightScheduler_AddSchedule(&scheduler, light, true, 13);
+   }
+
+   LightsShouldBeWrittenTogether(LIGHTSCHEDULER_WRITE_BATCH_SIZE);
+   LightsShouldBeWrittenTogether(1);
+   for(uint8_t light = 0; light < Capacity; light++)
+   {
+      LightShouldBeTurnedOn(light);
+   }
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldWriteALightOnceWithTheLastAddedStateWhenSeveralOfItsSchedulesAreDue)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 3, false, 13);
+
+   LightShouldBeTurnedOff(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldLetTheLastAddedScheduleWinRegardlessOfState)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, false, 13);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldLetTheEarlierScheduleWinOnceTheLaterOneIsRemoved)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+   LightSchedulerHandle_t later = LightScheduler_AddSchedule(&scheduler, 3, false, 13);
+   LightScheduler_RemoveScheduleByHandle(&scheduler, later);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldOrderByWhenSchedulesWereAddedNotByTheSlotTheyUse)
+{
+   LightSchedulerHandle_t first = LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 3, false, 13);
+   LightScheduler_RemoveScheduleByHandle(&scheduler, first);
+   LightSchedulerHandle_t last = LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+
+   CHECK_EQUAL(first.slot, last.slot);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldCoalesceEachLightSeparately)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 13);
+
+   LightShouldBeTurnedOff(1);
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldWriteCoalescedLightsTogether)
+{
+   GivenTheLightsCanWriteManyChannelsAtOnce();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 13);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 13);
+
+   LightsShouldBeWrittenTogether(2);
+   LightShouldBeTurnedOff(1);
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldWriteALightAgainWhenTheShadowIsNotEnabled)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldSkipAWriteThatMatchesTheShadow)
+{
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldWriteALightWhoseStateIsNotKnownYetEvenWhenTurningItOff)
+{
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 3, false, 12);
+
+   LightShouldBeTurnedOff(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+TEST(LightScheduler, ShouldWriteALightWhenItsStateChangesFromTheShadow)
+{
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, false, 13);
+   LightScheduler_AddSchedule(&scheduler, 4, false, 13);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightShouldBeTurnedOff(3);
+   LightShouldBeTurnedOff(4);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldNotWriteManyChannelsWhenEveryDueWriteMatchesTheShadow)
+{
+   GivenTheLightsCanWriteManyChannelsAtOnce();
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+
+   LightsShouldBeWrittenTogether(1);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldRewriteEveryKnownLightWhenTheShadowIsResynced)
+{
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 200, false, 12);
+   LightShouldBeTurnedOn(3);
+   LightShouldBeTurnedOff(200);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightShouldBeTurnedOn(3);
+   LightShouldBeTurnedOff(200);
+   LightScheduler_ResyncShadow(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRewriteKnownLightsTogetherWhenTheShadowIsResynced)
+{
+   GivenTheLightsCanWriteManyChannelsAtOnce();
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 4, true, 12);
+   LightsShouldBeWrittenTogether(2);
+   LightShouldBeTurnedOn(3);
+   LightShouldBeTurnedOn(4);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightsShouldBeWrittenTogether(2);
+   LightShouldBeTurnedOn(3);
+   LightShouldBeTurnedOn(4);
+   LightScheduler_ResyncShadow(&scheduler);
+}
+
+TEST(LightScheduler, ShouldNotWriteAnythingWhenResyncingWithoutAShadow)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   NothingShouldHappen();
+   LightScheduler_ResyncShadow(&scheduler);
+}
+
+TEST(LightScheduler, ShouldForgetTheShadowWhenItIsEnabledAgain)
+{
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 13);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightScheduler_EnableShadow(&scheduler);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(13);
+}
+
+TEST(LightScheduler, ShouldRunSchedulesWhoseTicksWereMissedBetweenRuns)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 4, true, 13);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(11);
+
+   LightShouldBeTurnedOn(3);
+   LightShouldBeTurnedOn(4);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldOnlyRunSchedulesDueAtTheCurrentTickTheFirstTimeItIsRun)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 4, true, 12);
+
+   LightShouldBeTurnedOn(4);
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+TEST(LightScheduler, ShouldNotRunAScheduleAgainWhenRunTwiceAtTheSameTick)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(12);
+}
+
+TEST(LightScheduler, ShouldNotRunAScheduleForTheTickOfThePreviousRunAgain)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 4, true, 13);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightShouldBeTurnedOn(4);
+   WhenTheLightSchedulerIsRunAtTime(15);
+}
+
+// The time source and schedule ticks wrap around together only when they are the same width
+#if LIGHTSCHEDULER_TICK_BITS == 16
+
+TEST(LightScheduler, ShouldCatchUpAcrossTheTickCountWrappingAround)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 0xFFFF);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 0);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 2);
+   LightScheduler_AddSchedule(&scheduler, 4, true, 3);
+   LightScheduler_AddSchedule(&scheduler, 5, true, 0xFFF0);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(0xFFF8);
+
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOn(2);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(2);
+}
+
+TEST(LightScheduler, ShouldCatchUpFromTheLastTickBeforeTheTickCountWrapsAround)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 0xFFFF);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 0);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(0xFFFF);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(3);
+}
+
+TEST(LightScheduler, ShouldLetTheScheduleDueLastWinWhenCatchingUp)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, false, 14);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(11);
+
+   LightShouldBeTurnedOff(3);
+   WhenTheLightSchedulerIsRunAtTime(15);
+}
+
+TEST(LightScheduler, ShouldLetTheScheduleDueLastWinWhenCatchingUpAcrossTheTickCountWrappingAround)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, false, 1);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 0xFFFE);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(0xFFF0);
+
+   LightShouldBeTurnedOff(3);
+   WhenTheLightSchedulerIsRunAtTime(5);
+}
+
+#endif
+
+#if LIGHTSCHEDULER_TICK_BITS > 16
+
+TEST(LightScheduler, ShouldNotRunAScheduleAgainWhenOnlyTheTimeSourceWrapsAround)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   WhenTheLightSchedulerIsRunAtTime(0x8000);
+   WhenTheLightSchedulerIsRunAtTime(0x10000);
+   WhenTheLightSchedulerIsRunAtTime(0x10000 + 12);
+}
+
+TEST(LightScheduler, ShouldRunAScheduleMoreThanOneTimeSourceWrapAhead)
+{
+   LightScheduler_AddSchedule(&scheduler, 3, true, 0x30000 + 12);
+
+   WhenTheLightSchedulerIsRunAtTime(12);
+   for(ScheduleTicks_t time = 0x8000; time < 0x30000; time += 0x8000)
+   {
+      WhenTheLightSchedulerIsRunAtTime(time);
+   }
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(0x30000 + 12);
+}
+
+TEST(LightScheduler, ShouldExtendTheTimeSourceTicksAcrossItsWrapAround)
+{
+   WhenTheLightSchedulerIsRunAtTime(0xFFF0);
+   CHECK_EQUAL(0xFFF0, LightScheduler_CurrentTicks(&scheduler));
+
+   WhenTheLightSchedulerIsRunAtTime(0x10010);
+   CHECK_EQUAL(0x10010, LightScheduler_CurrentTicks(&scheduler));
+}
+
+#endif
+
+TEST(LightScheduler, ShouldReportTheTickOfTheLastRun)
+{
+   CHECK_EQUAL(0, LightScheduler_CurrentTicks(&scheduler));
+
+   WhenTheLightSchedulerIsRunAtTime(12);
+   CHECK_EQUAL(12, LightScheduler_CurrentTicks(&scheduler));
+}
+
+// Schedules spread over several wraps of the time source must each run in the one run whose window
+// covers their time, however wide the schedule ticks are
+TEST(LightScheduler, ShouldRunEveryScheduleAtItsTimeThroughSeveralTimeSourceWrapArounds)
+{
+   enum { Lights = 8, Step = 999, Wraps = 5 };
+   ScheduleTicks_t times[Lights];
+
+   for(uint8_t light = 0; light < Lights; light++)
+   {
+      times[light] = (ScheduleTicks_t)(light * 40503u + 17);
+      LightScheduler_AddSchedule(&scheduler, light, true, times[light]);
+   }
+
+   WhenTheLightSchedulerIsRunAtTime(0);
+   ScheduleTicks_t previous = 0;
+
+   for(uint32_t now = Step; now < Wraps * 0x10000u; now += Step)
+   {
+      for(uint8_t light = 0; light < Lights; light++)
+      {
+         if((ScheduleTicks_t)(times[light] - previous - 1) < (ScheduleTicks_t)(now - previous))
+         {
+            LightShouldBeTurnedOn(light);
+         }
+      }
+
+      WhenTheLightSchedulerIsRunAtTime((ScheduleTicks_t)now);
+      mock().checkExpectations();
+      previous = (ScheduleTicks_t)now;
+   }
+}
+
+TEST(LightScheduler, ShouldRunARecurringScheduleEveryPeriod)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(21);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(22);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(32);
+}
+
+TEST(LightScheduler, ShouldRemoveARecurringScheduleAfterItsLastRun)
+{
+   LightSchedulerHandle_t handle = LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, 2);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+   CHECK_TRUE(LightScheduler_ScheduleExists(&scheduler, handle));
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(22);
+   CHECK_FALSE(LightScheduler_ScheduleExists(&scheduler, handle));
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(32);
+}
+
+TEST(LightScheduler, ShouldWriteOccurrencesOfARecurringScheduleThatCameDueInOneRunOnce)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 2, LIGHTSCHEDULER_REPEAT_FOREVER);
+   WhenTheLightSchedulerIsRunAtTime(11);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(19);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldOrderARecurringScheduleThatCameDueMoreThanOnceInOneRunByItsLastOccurrence)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 10, 5, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightScheduler_AddSchedule(&scheduler, 3, false, 12);
+   WhenTheLightSchedulerIsRunAtTime(9);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(16);
+}
+
+TEST(LightScheduler, ShouldNotOrderARecurringScheduleByOccurrencesAfterItsLastRun)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 10, 5, 1);
+   LightScheduler_AddSchedule(&scheduler, 3, false, 12);
+   WhenTheLightSchedulerIsRunAtTime(9);
+
+   LightShouldBeTurnedOff(3);
+   WhenTheLightSchedulerIsRunAtTime(16);
+}
+
+TEST(LightScheduler, ShouldCountEveryOccurrenceThatCameDueInOneRunAsARun)
+{
+   LightSchedulerHandle_t handle = LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 2, 3);
+   WhenTheLightSchedulerIsRunAtTime(11);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(15);
+   CHECK_TRUE(LightScheduler_ScheduleExists(&scheduler, handle));
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(30);
+   CHECK_FALSE(LightScheduler_ScheduleExists(&scheduler, handle));
+}
+
+TEST(LightScheduler, ShouldStopARecurringScheduleRemovedByHandle)
+{
+   LightSchedulerHandle_t handle = LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   CHECK_TRUE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(22);
+}
+
+TEST(LightScheduler, ShouldRemoveARecurringScheduleAtTheTimeOfItsNextRun)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightScheduler_RemoveSchedule(&scheduler, 3, true, 22);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(22);
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldOrderARecurringScheduleAsIfItWasAddedAgainWhenItRan)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightScheduler_AddSchedule(&scheduler, 3, false, 22);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(22);
+}
+
+TEST(LightScheduler, ShouldLetAScheduleAddedAfterARecurringScheduleRanWinAtItsNextRun)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightScheduler_AddSchedule(&scheduler, 1, false, 20);
+   LightShouldBeTurnedOff(1);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldWalkARecurringScheduleThatRanAsTheNewestForItsLight)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 20);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightSchedulerLightIterator_t iterator;
+   Schedule_t schedule;
+   LightScheduler_IterateLight(&scheduler, 1, &iterator);
+   CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+   CHECK_TRUE(schedule.lightState);
+   CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+   CHECK_FALSE(schedule.lightState);
+   CHECK_FALSE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldKeepRecurringSchedulesThatRanTogetherInTheOrderTheyWereAdded)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, false, 12, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+
+   LightShouldBeTurnedOff(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightShouldBeTurnedOff(3);
+   WhenTheLightSchedulerIsRunAtTime(22);
+}
+
+TEST(LightScheduler, ShouldNotAddARecurringScheduleWhenThereIsNoRoom)
+{
+   enum { Capacity = 1 };
+   LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(Capacity)];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 13);
+
+   LightSchedulerHandle_t handle = LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, 2);
+
+   CHECK_EQUAL(0, handle.generation);
+}
+
+TEST(LightScheduler, ShouldAssertWhenARecurringScheduleHasNoPeriod)
+{
+   CHECK_ASSERTION_FAILED(LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 0, 2));
+}
+
+TEST(LightScheduler, ShouldKeepARecurringScheduleRunningWhileOtherSchedulesComeAndGo)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 1, 1, LIGHTSCHEDULER_REPEAT_FOREVER);
+
+   for(ScheduleTicks_t time = 1; time < 100; time++)
+   {
+      LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 4, true, (ScheduleTicks_t)(time + 1));
+      LightShouldBeTurnedOn(3);
+      WhenTheLightSchedulerIsRunAtTime(time);
+      LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+   }
+
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldRunSchedulesKeptInATimingWheel)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 20);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12 + 8);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(11);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldLetTheLastAddedScheduleWinInATimingWheel)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+   LightScheduler_AddSchedule(&scheduler, 3, false, 14);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 4, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 4, false, 12);
+   WhenTheLightSchedulerIsRunAtTime(11);
+
+   LightShouldBeTurnedOff(3);
+   LightShouldBeTurnedOff(4);
+   WhenTheLightSchedulerIsRunAtTime(15);
+}
+
+TEST(LightScheduler, ShouldRemoveSchedulesFromATimingWheel)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+   LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 1, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 12);
+
+   CHECK_TRUE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+   LightScheduler_RemoveSchedule(&scheduler, 3, true, 12);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(12);
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldRunRecurringSchedulesKeptInATimingWheel)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 5, 3);
+
+   for(ScheduleTicks_t time = 12; time <= 22; time += 5)
+   {
+      LightShouldBeTurnedOn(3);
+      WhenTheLightSchedulerIsRunAtTime(time);
+   }
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(27);
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldReportNoRoomWhenATimingWheelIsFull)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+
+   for(uint8_t light = 0; light < 16; light++)
+   {
+      CHECK_EQUAL(LightSchedulerStatus_Ok, LightScheduler_TryAddSchedule(&scheduler, light, true, light, NULL));
+   }
+
+   CHECK_EQUAL(LightSchedulerStatus_Full, LightScheduler_TryAddSchedule(&scheduler, 16, true, 16, NULL));
+}
+
+TEST(LightScheduler, ShouldHaveNoNextDueTickWithoutSchedules)
+{
+   ScheduleTicks_t tick;
+   CHECK_FALSE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_FALSE(LightScheduler_TicksUntilDue(&scheduler, &tick));
+}
+
+TEST(LightScheduler, ShouldFindTheNextDueTickAfterTheLastRun)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 12);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 20);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   ScheduleTicks_t tick;
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(20, tick);
+   CHECK_TRUE(LightScheduler_TicksUntilDue(&scheduler, &tick));
+   CHECK_EQUAL(8, tick);
+}
+
+TEST(LightScheduler, ShouldFindANextDueTickAtTickZeroBeforeTheFirstRun)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 0);
+
+   ScheduleTicks_t tick;
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(0, tick);
+}
+
+TEST(LightScheduler, ShouldWrapAroundToFindTheNextDueTick)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 12);
+   WhenTheLightSchedulerIsRunAtTime(20);
+
+   ScheduleTicks_t tick;
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(12, tick);
+   CHECK_TRUE(LightScheduler_TicksUntilDue(&scheduler, &tick));
+   CHECK_EQUAL((ScheduleTicks_t)(12 - 20), tick);
+}
+
+TEST(LightScheduler, ShouldReportTheMostTicksUntilAScheduleThatJustRanIsDueAgain)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 12);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   ScheduleTicks_t ticks;
+   CHECK_TRUE(LightScheduler_TicksUntilDue(&scheduler, &ticks));
+   CHECK_EQUAL(SCHEDULETICKS_MAX, ticks);
+}
+
+TEST(LightScheduler, ShouldFindTheNextRunOfARecurringSchedule)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 12, 100, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(12);
+
+   ScheduleTicks_t ticks;
+   CHECK_TRUE(LightScheduler_TicksUntilDue(&scheduler, &ticks));
+   CHECK_EQUAL(100, ticks);
+}
+
+TEST(LightScheduler, ShouldFindTheNextDueTickInATimingWheel)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 500);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 30);
+   WhenTheLightSchedulerIsRunAtTime(20);
+
+   ScheduleTicks_t tick;
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(30, tick);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(30);
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(500, tick);
+}
+
+TEST(LightScheduler, ShouldRunSchedulesLoadedFromATable)
+{
+   const Schedule_t table[] = { { 3, true, 20 }, { 1, true, 10 }, { 2, false, 10 } };
+   CHECK_EQUAL(LightSchedulerStatus_Ok, LightScheduler_LoadSchedules(&scheduler, table, 3));
+   CHECK_EQUAL(3, LightScheduler_ScheduleCount(&scheduler));
+
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOff(2);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldLetTheLaterEntryInATableWinAmongSchedulesDueAtTheSameTick)
+{
+   const Schedule_t table[] = { { 1, false, 30 }, { 1, true, 10 }, { 1, true, 30 }, { 1, false, 10 } };
+   LightScheduler_LoadSchedules(&scheduler, table, 4);
+
+   LightShouldBeTurnedOff(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(30);
+}
+
+TEST(LightScheduler, ShouldLoadATableAfterSchedulesThatWereAlreadyAdded)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   const Schedule_t table[] = { { 1, false, 10 }, { 2, true, 5 } };
+   LightScheduler_LoadSchedules(&scheduler, table, 2);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(5);
+
+   LightShouldBeTurnedOff(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+}
+
+TEST(LightScheduler, ShouldNotLoadAnyOfATableThatDoesNotFit)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+
+   Schedule_t table[MAX_SCHEDULES];
+   for(uint8_t i = 0; i < MAX_SCHEDULES; i++)
+   {
+      table[i].lightId = i;
+      table[i].lightState = true;
+      table[i].time = 10;
+   }
+
+   CHECK_EQUAL(LightSchedulerStatus_Full, LightScheduler_LoadSchedules(&scheduler, table, MAX_SCHEDULES));
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldLoadALargeTableInAnyOrder)
+{
+   enum { Capacity = 200 };
+   static LightSchedulerStorage_t storage[LIGHTSCHEDULER_STORAGE_LENGTH(Capacity)];
+   LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, Capacity);
+
+   Schedule_t table[Capacity];
+   for(uint8_t i = 0; i < Capacity; i++)
+   {
+      table[i].lightId = i;
+      table[i].lightState = true;
+      table[i].time = (ScheduleTicks_t)((i * 37) % 50);
+   }
+   LightScheduler_LoadSchedules(&scheduler, table, Capacity);
+
+   for(ScheduleTicks_t time = 0; time < 50; time++)
+   {
+      for(uint8_t i = 0; i < Capacity; i++)
+      {
+         if(table[i].time == time)
+         {
+            LightShouldBeTurnedOn(i);
+         }
+      }
+      WhenTheLightSchedulerIsRunAtTime(time);
+   }
+}
+
+TEST(LightScheduler, ShouldLoadATableIntoATimingWheel)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+   const Schedule_t table[] = { { 2, true, 9 }, { 1, true, 1 }, { 1, false, 9 } };
+   LightScheduler_LoadSchedules(&scheduler, table, 3);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(1);
+
+   LightShouldBeTurnedOn(2);
+   LightShouldBeTurnedOff(1);
+   WhenTheLightSchedulerIsRunAtTime(9);
+}
+
+TEST(LightScheduler, ShouldRunSchedulesFromAnImage)
+{
+   static const Schedule_t image[] = { { 1, true, 10 }, { 2, true, 10 }, { 1, false, 20 } };
+   LightScheduler_UseScheduleImage(&scheduler, image, 3);
+
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOff(1);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldNotCountImageEntriesAsSchedules)
+{
+   static const Schedule_t image[] = { { 1, true, 10 } };
+   LightScheduler_UseScheduleImage(&scheduler, image, 1);
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldLetAnAddedScheduleWinOverAnImageEntryDueAtTheSameTick)
+{
+   static const Schedule_t image[] = { { 1, true, 10 } };
+   LightScheduler_UseScheduleImage(&scheduler, image, 1);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 10);
+
+   LightShouldBeTurnedOff(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+}
+
+TEST(LightScheduler, ShouldLetAnImageEntryDueLaterWinWhenCatchingUp)
+{
+   static const Schedule_t image[] = { { 1, true, 12 } };
+   LightScheduler_UseScheduleImage(&scheduler, image, 1);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 11);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 13);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOn(1);
+   LightShouldBeTurnedOff(2);
+   WhenTheLightSchedulerIsRunAtTime(15);
+}
+
+TEST(LightScheduler, ShouldRunEveryImageEntryWhenRunEveryTick)
+{
+   enum { Entries = 40 };
+   static Schedule_t image[Entries];
+   for(uint8_t i = 0; i < Entries; i++)
+   {
+      image[i].lightId = i;
+      image[i].lightState = true;
+      image[i].time = (ScheduleTicks_t)(i / 2);
+   }
+   LightScheduler_UseScheduleImage(&scheduler, image, Entries);
+
+   for(ScheduleTicks_t time = 0; time < Entries / 2; time++)
+   {
+      LightShouldBeTurnedOn((uint8_t)(2 * time));
+      LightShouldBeTurnedOn((uint8_t)(2 * time + 1));
+      WhenTheLightSchedulerIsRunAtTime(time);
+   }
+}
+
+TEST(LightScheduler, ShouldFindImageEntriesAfterSkippingPastManyOfThem)
+{
+   enum { Entries = 40 };
+   static Schedule_t image[Entries];
+   for(uint8_t i = 0; i < Entries; i++)
+   {
+      image[i].lightId = i;
+      image[i].lightState = true;
+      image[i].time = (ScheduleTicks_t)(10 * i);
+   }
+   LightScheduler_UseScheduleImage(&scheduler, image, Entries);
+
+   LightShouldBeTurnedOn(30);
+   WhenTheLightSchedulerIsRunAtTime(300);
+
+   ScheduleTicks_t tick;
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(310, tick);
+
+   LightShouldBeTurnedOn(31);
+   WhenTheLightSchedulerIsRunAtTime(310);
+}
+
+TEST(LightScheduler, ShouldFindTheNearerOfAnImageEntryAndAScheduleAsTheNextDueTick)
+{
+   static const Schedule_t image[] = { { 1, true, 10 }, { 1, true, 30 } };
+   LightScheduler_UseScheduleImage(&scheduler, image, 2);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 20);
+
+   ScheduleTicks_t tick;
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(10, tick);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(20, tick);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(20);
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(30, tick);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(30);
+   CHECK_TRUE(LightScheduler_NextDueTick(&scheduler, &tick));
+   CHECK_EQUAL(10, tick);
+}
+
+TEST(LightScheduler, ShouldStopRunningAnImageThatIsNoLongerUsed)
+{
+   static const Schedule_t image[] = { { 1, true, 10 } };
+   LightScheduler_UseScheduleImage(&scheduler, image, 1);
+   LightScheduler_UseScheduleImage(&scheduler, NULL, 0);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(10);
+}
+
+TEST(LightScheduler, ShouldAssertWhenAnImageIsNotInOrderOfTime)
+{
+   static const Schedule_t image[] = { { 1, true, 20 }, { 1, true, 10 } };
+   CHECK_ASSERTION_FAILED(LightScheduler_UseScheduleImage(&scheduler, image, 2));
+}
+
+#if LIGHTSCHEDULER_TICK_BITS == 16
+TEST(LightScheduler, ShouldRunImageEntriesAcrossTheTickCountWrappingAround)
+{
+   static const Schedule_t image[] = { { 1, true, 1 }, { 2, true, 5 }, { 3, true, 0xFFFE } };
+   LightScheduler_UseScheduleImage(&scheduler, image, 3);
+   WhenTheLightSchedulerIsRunAtTime(0xFFF0);
+
+   LightShouldBeTurnedOn(3);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(2);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(5);
+}
+#endif
+
+#if defined(LIGHTSCHEDULER_PACKED_SCHEDULES) || ((LIGHTSCHEDULER_TICK_BITS == 16) && (LIGHTSCHEDULER_LIGHT_ID_BITS == 8))
+TEST(LightScheduler, ShouldStoreSchedulesWithoutPadding)
+{
+   CHECK_EQUAL(sizeof(LightSchedulerLightId_t) + sizeof(bool) + sizeof(ScheduleTicks_t), sizeof(Schedule_t));
+}
+#endif
+
+#if LIGHTSCHEDULER_LIGHT_ID_BITS == 16
+TEST(LightScheduler, ShouldScheduleLightsBeyondTheFirst256)
+{
+   LightScheduler_AddSchedule(&scheduler, 300, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 300 % 256, false, 10);
+
+   LightShouldBeTurnedOn(300);
+   LightShouldBeTurnedOff(300 % 256);
+   WhenTheLightSchedulerIsRunAtTime(10);
+}
+
+TEST(LightScheduler, ShouldRememberTheStateOfLightsBeyondTheFirst256)
+{
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, LIGHTSCHEDULER_LIGHT_COUNT - 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, LIGHTSCHEDULER_LIGHT_COUNT - 1, true, 20);
+
+   LightShouldBeTurnedOn(LIGHTSCHEDULER_LIGHT_COUNT - 1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+#endif
+
+#if LIGHTSCHEDULER_LIGHT_COUNT < (1UL << LIGHTSCHEDULER_LIGHT_ID_BITS)
+TEST(LightScheduler, ShouldAssertWhenALightIdIsBeyondTheLightCount)
+{
+   CHECK_ASSERTION_FAILED(LightScheduler_AddSchedule(&scheduler, LIGHTSCHEDULER_LIGHT_COUNT, true, 10));
+}
+
+TEST(LightScheduler, ShouldAssertWhenATableHasALightIdBeyondTheLightCount)
+{
+   const Schedule_t table[] = { { 1, true, 10 }, { LIGHTSCHEDULER_LIGHT_COUNT, true, 20 } };
+   CHECK_ASSERTION_FAILED(LightScheduler_LoadSchedules(&scheduler, table, 2));
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldAssertWhenAnImageHasALightIdBeyondTheLightCount)
+{
+   static const Schedule_t image[] = { { LIGHTSCHEDULER_LIGHT_COUNT, true, 10 } };
+   CHECK_ASSERTION_FAILED(LightScheduler_UseScheduleImage(&scheduler, image, 1));
+}
+
+TEST(LightScheduler, ShouldRemoveNothingForALightIdBeyondTheLightCount)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+
+   CHECK_EQUAL(0, LightScheduler_RemoveAllForLight(&scheduler, LIGHTSCHEDULER_LIGHT_COUNT));
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldIgnoreCommandsForALightIdBeyondTheLightCount)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+
+   const LightSchedulerCommand_t commands[] = {
+      { LightSchedulerCommandType_Add, true, LIGHTSCHEDULER_LIGHT_COUNT, 10, 0, 0 },
+      { LightSchedulerCommandType_AddRecurring, true, LIGHTSCHEDULER_LIGHT_COUNT, 10, 5, 2 },
+      { LightSchedulerCommandType_RemoveAllForLight, false, LIGHTSCHEDULER_LIGHT_COUNT, 0, 0, 0 },
+      { LightSchedulerCommandType_RemoveOne, true, LIGHTSCHEDULER_LIGHT_COUNT, 10, 0, 0 }
+   };
+   for(uint8_t i = 0; i < 4; i++)
+   {
+      LightScheduler_ApplyCommand(&scheduler, &commands[i]);
+   }
+
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldAssertWhenIteratingALightIdBeyondTheLightCount)
+{
+   LightSchedulerLightIterator_t iterator;
+   CHECK_ASSERTION_FAILED(LightScheduler_IterateLight(&scheduler, LIGHTSCHEDULER_LIGHT_COUNT, &iterator));
+}
+#endif
+
+TEST(LightScheduler, ShouldRemoveEveryScheduleForALight)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, false, 20, 5, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 30);
+
+   CHECK_EQUAL(3, LightScheduler_RemoveAllForLight(&scheduler, 1));
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   NothingShouldHappen();
+   WhenTheLightSchedulerIsRunAtTime(30);
+}
+
+TEST(LightScheduler, ShouldRemoveNothingForALightWithoutSchedules)
+{
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   CHECK_EQUAL(0, LightScheduler_RemoveAllForLight(&scheduler, 1));
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldReuseTheSlotsOfSchedulesRemovedForALight)
+{
+   for(uint8_t i = 0; i < MAX_SCHEDULES; i++)
+   {
+      LightScheduler_AddSchedule(&scheduler, i % 2, true, i);
+   }
+
+   LightScheduler_RemoveAllForLight(&scheduler, 0);
+
+   for(uint8_t i = 0; i < MAX_SCHEDULES / 2; i++)
+   {
+      CHECK_EQUAL(LightSchedulerStatus_Ok, LightScheduler_TryAddSchedule(&scheduler, 3, true, 50, NULL));
+   }
+   CHECK_EQUAL(LightSchedulerStatus_Full, LightScheduler_TryAddSchedule(&scheduler, 3, true, 50, NULL));
+   CHECK_EQUAL(MAX_SCHEDULES / 2, LightScheduler_RemoveAllForLight(&scheduler, 1));
+}
+
+TEST(LightScheduler, ShouldWalkTheSchedulesForALightMostRecentlyAddedFirst)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 15);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 20);
+
+   LightSchedulerLightIterator_t iterator;
+   Schedule_t schedule;
+   LightScheduler_IterateLight(&scheduler, 1, &iterator);
+
+   CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+   CHECK_EQUAL(1, schedule.lightId);
+   CHECK_FALSE(schedule.lightState);
+   CHECK_EQUAL(20, schedule.time);
+
+   CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+   CHECK_TRUE(schedule.lightState);
+   CHECK_EQUAL(10, schedule.time);
+
+   CHECK_FALSE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+}
+
+TEST(LightScheduler, ShouldWalkNoSchedulesForALightWithoutSchedules)
+{
+   LightSchedulerLightIterator_t iterator;
+   Schedule_t schedule;
+   LightScheduler_IterateLight(&scheduler, 1, &iterator);
+   CHECK_FALSE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+}
+
+TEST(LightScheduler, ShouldLetAScheduleFoundForALightBeRemovedWhileWalking)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 20);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 30);
+
+   LightSchedulerLightIterator_t iterator;
+   Schedule_t schedule;
+   LightSchedulerHandle_t handle;
+   LightScheduler_IterateLight(&scheduler, 1, &iterator);
+
+   while(LightScheduler_NextForLight(&iterator, &schedule, &handle))
+   {
+      if(schedule.lightState)
+      {
+         CHECK_TRUE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+      }
+   }
+
+   LightScheduler_IterateLight(&scheduler, 1, &iterator);
+   CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+   CHECK_EQUAL(20, schedule.time);
+   CHECK_FALSE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+}
+
+TEST(LightScheduler, ShouldWalkTheNextRunOfARecurringScheduleForALight)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 100, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightSchedulerLightIterator_t iterator;
+   Schedule_t schedule;
+   LightScheduler_IterateLight(&scheduler, 1, &iterator);
+   CHECK_TRUE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+   CHECK_EQUAL(110, schedule.time);
+}
+
+TEST(LightScheduler, ShouldNotWalkSchedulesThatRanOutOrWereRemoved)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 100, 1);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 20);
+   LightScheduler_RemoveSchedule(&scheduler, 1, false, 20);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightSchedulerLightIterator_t iterator;
+   Schedule_t schedule;
+   LightScheduler_IterateLight(&scheduler, 1, &iterator);
+   CHECK_FALSE(LightScheduler_NextForLight(&iterator, &schedule, NULL));
+}
+
+TEST(LightScheduler, ShouldRemoveEveryScheduleForALightFromATimingWheel)
+{
+   GivenTheSchedulesAreKeptInATimingWheel();
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 18);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 18);
+
+   CHECK_EQUAL(2, LightScheduler_RemoveAllForLight(&scheduler, 1));
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(18);
+}
+
+TEST(LightScheduler, ShouldSerializeToTheSizeItReports)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 20);
+
+   GivenTheSchedulesHaveBeenSerialized();
+   CHECK_EQUAL(LIGHTSCHEDULER_SNAPSHOT_SIZE(2), snapshotSize);
+   CHECK_EQUAL(snapshotSize, LightScheduler_SnapshotSize(&scheduler));
+}
+
+TEST(LightScheduler, ShouldNotSerializeIntoABufferThatIsTooSmall)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   CHECK_EQUAL(
+      LightSchedulerSnapshotStatus_BufferTooSmall,
+      LightScheduler_Serialize(&scheduler, snapshot, LIGHTSCHEDULER_SNAPSHOT_SIZE(1) - 1, NULL));
+}
+
+TEST(LightScheduler, ShouldRunSchedulesRestoredFromASnapshot)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 20);
+   LightScheduler_AddSchedule(&scheduler, 3, true, 5);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   WhenTheLightSchedulerIsRestartedFromTheSnapshot();
+   CHECK_EQUAL(3, LightScheduler_ScheduleCount(&scheduler));
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(5);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOff(2);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldRestoreTheRunsARecurringScheduleHasLeft)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 12, 10, 3);
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(12);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   WhenTheLightSchedulerIsRestartedFromTheSnapshot();
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(22);
+
+   LightShouldBeTurnedOn(3);
+   WhenTheLightSchedulerIsRunAtTime(32);
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldLetTheSameScheduleWinAtTheSameTickAfterARestore)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, false, 30);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 30);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   WhenTheLightSchedulerIsRestartedFromTheSnapshot();
+
+   LightShouldBeTurnedOff(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(30);
+}
+
+TEST(LightScheduler, ShouldLetARecurringScheduleThatRanWinAtTheSameTickAfterARestore)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 10, LIGHTSCHEDULER_REPEAT_FOREVER);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 20);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   WhenTheLightSchedulerIsRestartedFromTheSnapshot();
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(20);
+}
+
+TEST(LightScheduler, ShouldReplaceTheSchedulesThatWereThereWhenRestoring)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   LightSchedulerHandle_t handle = LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_Ok, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize));
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+   CHECK_FALSE(LightScheduler_ScheduleExists(&scheduler, handle));
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+}
+
+TEST(LightScheduler, ShouldAddSchedulesAfterARestoreUntilFull)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   WhenTheLightSchedulerIsRestartedFromTheSnapshot();
+
+   for(uint8_t i = 2; i < MAX_SCHEDULES; i++)
+   {
+      CHECK_EQUAL(LightSchedulerStatus_Ok, LightScheduler_TryAddSchedule(&scheduler, 3, true, 20, NULL));
+   }
+   CHECK_EQUAL(LightSchedulerStatus_Full, LightScheduler_TryAddSchedule(&scheduler, 3, true, 20, NULL));
+   CHECK_EQUAL(2, LightScheduler_RemoveAllForLight(&scheduler, 1) + LightScheduler_RemoveAllForLight(&scheduler, 2));
+}
+
+TEST(LightScheduler, ShouldRestoreASnapshotIntoATimingWheel)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 30);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   GivenTheSchedulesAreKeptInATimingWheel();
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_Ok, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize));
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(30);
+}
+
+TEST(LightScheduler, ShouldNotRestoreMoreSchedulesThanFit)
+{
+   uint8_t largeSnapshot[LIGHTSCHEDULER_SNAPSHOT_SIZE(MAX_SCHEDULES + 1)];
+   uint32_t largeSnapshotSize;
+
+   GivenTheSchedulesAreKeptInATimingWheel();
+   for(uint8_t i = 0; i < MAX_SCHEDULES + 1; i++)
+   {
+      LightScheduler_AddSchedule(&scheduler, i, true, 10);
+   }
+   LightScheduler_Serialize(&scheduler, largeSnapshot, sizeof(largeSnapshot), &largeSnapshotSize);
+
+   LightScheduler_Init(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 20);
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_Full, LightScheduler_Deserialize(&scheduler, largeSnapshot, largeSnapshotSize));
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldNotRestoreASnapshotThatHasBeenChanged)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   GivenTheSchedulesHaveBeenSerialized();
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+
+   snapshot[LIGHTSCHEDULER_SNAPSHOT_HEADER_SIZE] ^= 1;
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_Corrupt, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize));
+   CHECK_EQUAL(2, LightScheduler_ScheduleCount(&scheduler));
+}
+
+TEST(LightScheduler, ShouldNotRestoreSomethingThatIsNotASnapshot)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_NotASnapshot, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize - 1));
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_NotASnapshot, LightScheduler_Deserialize(&scheduler, snapshot, 3));
+
+   snapshot[0] ^= 1;
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_NotASnapshot, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize));
+}
+
+TEST(LightScheduler, ShouldNotRestoreASnapshotFromAnotherVersionOrConfiguration)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   GivenTheSchedulesHaveBeenSerialized();
+
+   snapshot[4] ^= 1;
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_UnsupportedVersion, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize));
+   snapshot[4] ^= 1;
+
+   snapshot[6] ^= 1;
+   CHECK_EQUAL(LightSchedulerSnapshotStatus_ConfigurationMismatch, LightScheduler_Deserialize(&scheduler, snapshot, snapshotSize));
+}
+
+#ifdef LIGHTSCHEDULER_STATS
+TEST(LightScheduler, ShouldCountRunsAndHowManyCyclesTheyTook)
+{
+   LightSchedulerStats_t stats;
+
+   WhenTheLightSchedulerIsRunAtTime(1);
+   WhenTheLightSchedulerIsRunAtTime(2);
+   WhenTheLightSchedulerIsRunAtTime(3);
+
+   CHECK_TRUE(LightScheduler_GetStats(&scheduler, &stats));
+   CHECK_EQUAL(3, stats.runs);
+   CHECK(stats.minCycles <= stats.maxCycles);
+
+   uint32_t histogramRuns = 0;
+   for(uint8_t bucket = 0; bucket < LIGHTSCHEDULER_STATS_HISTOGRAM_BUCKETS; bucket++)
+   {
+      histogramRuns += stats.cycleHistogram[bucket];
+   }
+   CHECK_EQUAL(3, histogramRuns);
+}
+
+TEST(LightScheduler, ShouldCountDueSchedulesAndTheWritesTheyMade)
+{
+   static const Schedule_t image[] = { { 2, true, 10 } };
+   LightSchedulerStats_t stats;
+
+   LightScheduler_UseScheduleImage(&scheduler, image, 1);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 1, false, 10);
+
+   LightShouldBeTurnedOff(1);
+   LightShouldBeTurnedOn(2);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightScheduler_GetStats(&scheduler, &stats);
+   CHECK_EQUAL(3, stats.due);
+   CHECK_EQUAL(2, stats.writes);
+}
+
+TEST(LightScheduler, ShouldNotCountWritesTheShadowSkipped)
+{
+   LightSchedulerStats_t stats;
+
+   LightScheduler_EnableShadow(&scheduler);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 20);
+
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+   WhenTheLightSchedulerIsRunAtTime(20);
+
+   LightScheduler_GetStats(&scheduler, &stats);
+   CHECK_EQUAL(2, stats.due);
+   CHECK_EQUAL(1, stats.writes);
+}
+
+TEST(LightScheduler, ShouldCountSchedulesThatWereNotAddedForLackOfSlots)
+{
+   LightSchedulerStats_t stats;
+
+   for(uint8_t i = 0; i < MAX_SCHEDULES + 2; i++)
+   {
+      LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   }
+
+   LightScheduler_GetStats(&scheduler, &stats);
+   CHECK_EQUAL(2, stats.insertFailures);
+}
+
+TEST(LightScheduler, ShouldCountEveryScheduleInATableThatDidNotFit)
+{
+   LightSchedulerStats_t stats;
+
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+
+   Schedule_t table[MAX_SCHEDULES];
+   for(uint8_t i = 0; i < MAX_SCHEDULES; i++)
+   {
+      table[i].lightId = i;
+      table[i].lightState = true;
+      table[i].time = 10;
+   }
+   LightScheduler_LoadSchedules(&scheduler, table, MAX_SCHEDULES);
+
+   LightScheduler_GetStats(&scheduler, &stats);
+   CHECK_EQUAL(MAX_SCHEDULES, stats.insertFailures);
+}
+
+TEST(LightScheduler, ShouldCountEveryScheduleInASnapshotThatDidNotFit)
+{
+   uint8_t largeSnapshot[LIGHTSCHEDULER_SNAPSHOT_SIZE(MAX_SCHEDULES + 1)];
+   uint32_t largeSnapshotSize;
+   LightSchedulerStats_t stats;
+
+   GivenTheSchedulesAreKeptInATimingWheel();
+   for(uint8_t i = 0; i < MAX_SCHEDULES + 1; i++)
+   {
+      LightScheduler_AddSchedule(&scheduler, i, true, 10);
+   }
+   LightScheduler_Serialize(&scheduler, largeSnapshot, sizeof(largeSnapshot), &largeSnapshotSize);
+
+   LightScheduler_Init(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
+   LightScheduler_Deserialize(&scheduler, largeSnapshot, largeSnapshotSize);
+
+   LightScheduler_GetStats(&scheduler, &stats);
+   CHECK_EQUAL(MAX_SCHEDULES + 1, stats.insertFailures);
+}
+
+TEST(LightScheduler, ShouldStartCountingAgainWhenTheStatsAreReset)
+{
+   LightSchedulerStats_t stats;
+
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightShouldBeTurnedOn(1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+
+   LightScheduler_ResetStats(&scheduler);
+   LightScheduler_GetStats(&scheduler, &stats);
+   CHECK_EQUAL(0, stats.runs);
+   CHECK_EQUAL(UINT32_MAX, stats.minCycles);
+   CHECK_EQUAL(0, stats.maxCycles);
+   CHECK_EQUAL(0, stats.due);
+   CHECK_EQUAL(0, stats.writes);
+}
+
+TEST(LightScheduler, ShouldKeepCountingInTheLightSchedulerThatTakesOver)
+{
+   LightScheduler_t next;
+   LightSchedulerStats_t stats;
+
+   WhenTheLightSchedulerIsRunAtTime(1);
+   LightScheduler_Init(&next, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
+   LightScheduler_TakeOverFrom(&next, &scheduler);
+
+   LightScheduler_GetStats(&next, &stats);
+   CHECK_EQUAL(1, stats.runs);
+}
+#else
+TEST(LightScheduler, ShouldNotReportStatsWhenTheyAreNotCompiledIn)
+{
+   LightSchedulerStats_t stats;
+
+   WhenTheLightSchedulerIsRunAtTime(1);
+   CHECK_FALSE(LightScheduler_GetStats(&scheduler, &stats));
+   CHECK_EQUAL(0, stats.runs);
+}
+#endif
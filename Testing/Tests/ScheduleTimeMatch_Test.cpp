@@ -0,0 +1,128 @@
+/*!
+ * @file
+ * @brief Tests for schedule time matching kernels.
+ */
+
+extern "C"
+{
+#include "ScheduleTimeMatch.h"
+}
+
+#include "CppUTest/TestHarness.h"
+#include "uassert_test.h"
+
+enum
+{
+   RandomBlocks = 2000
+};
+
+TEST_GROUP(ScheduleTimeMatch)
+{
+   ScheduleTicks_t times[SCHEDULETIMEMATCH_BLOCK_SIZE];
+   uint32_t seed;
+
+   void setup()
+   {
+      seed = 12345;
+   }
+
+   uint32_t Random()
+   {
+      seed = seed * 1664525u + 1013904223u;
+      return seed >> 8;
+   }
+
+   // Times are drawn from a few values so that every block has a mix of due and not due entries
+   ScheduleTicks_t GivenARandomBlock(uint32_t count)
+   {
+      ScheduleTicks_t base = (ScheduleTicks_t)Random();
+
+      for(uint32_t i = 0; i < count; i++)
+      {
+         times[i] = (ScheduleTicks_t)(base + Random() % 3);
+      }
+
+      return (ScheduleTicks_t)(base + Random() % 3);
+   }
+
+   // Times that only differ from the due time in their top bits catch a kernel that compares too few bits
+   void KernelShouldCompareWholeTimes(ScheduleTimeMatch_DueMask_t kernel)
+   {
+      for(uint32_t i = 0; i < SCHEDULETIMEMATCH_BLOCK_SIZE; i++)
+      {
+         times[i] = (ScheduleTicks_t)(7 + ((ScheduleTicks_t)i << (LIGHTSCHEDULER_TICK_BITS - 8)));
+      }
+
+      CHECK_EQUAL(1, kernel(times, SCHEDULETIMEMATCH_BLOCK_SIZE, 7));
+   }
+
+   void KernelShouldMatchTheScalarKernel(ScheduleTimeMatch_DueMask_t kernel)
+   {
+      KernelShouldCompareWholeTimes(kernel);
+
+      for(uint32_t block = 0; block < RandomBlocks; block++)
+      {
+         uint32_t count = Random() % (SCHEDULETIMEMATCH_BLOCK_SIZE + 1);
+         ScheduleTicks_t ticks = GivenARandomBlock(count);
+
+         CHECK_EQUAL(ScheduleTimeMatch_DueMaskScalar(times, count, ticks), kernel(times, count, ticks));
+      }
+   }
+};
+
+TEST(ScheduleTimeMatch, ScalarKernelShouldSetABitForEachDueTime)
+{
+   const ScheduleTicks_t someTimes[] = { 12, 13, 12, 0, 65535, 12 };
+
+   CHECK_EQUAL(0x25, ScheduleTimeMatch_DueMaskScalar(someTimes, 6, 12));
+   CHECK_EQUAL(0x10, ScheduleTimeMatch_DueMaskScalar(someTimes, 6, 65535));
+   CHECK_EQUAL(0x05, ScheduleTimeMatch_DueMaskScalar(someTimes, 4, 12));
+   CHECK_EQUAL(0, ScheduleTimeMatch_DueMaskScalar(someTimes, 6, 14));
+}
+
+TEST(ScheduleTimeMatch, ScalarKernelShouldSetEveryBitForAFullBlockOfDueTimes)
+{
+   for(uint32_t i = 0; i < SCHEDULETIMEMATCH_BLOCK_SIZE; i++)
+   {
+      times[i] = 7;
+   }
+
+   CHECK_EQUAL(0xFFFFFFFF, ScheduleTimeMatch_DueMaskScalar(times, SCHEDULETIMEMATCH_BLOCK_SIZE, 7));
+}
+
+TEST(ScheduleTimeMatch, SelectedKernelShouldMatchTheScalarKernelForRandomBlocks)
+{
+   KernelShouldMatchTheScalarKernel(ScheduleTimeMatch_DueMask);
+}
+
+#ifdef SCHEDULETIMEMATCH_X86_KERNELS
+
+TEST(ScheduleTimeMatch, Sse2KernelShouldMatchTheScalarKernelForRandomBlocks)
+{
+   KernelShouldMatchTheScalarKernel(ScheduleTimeMatch_DueMaskSse2);
+}
+
+TEST(ScheduleTimeMatch, Sse2KernelShouldSetEveryBitForAFullBlockOfDueTimes)
+{
+   for(uint32_t i = 0; i < SCHEDULETIMEMATCH_BLOCK_SIZE; i++)
+   {
+      times[i] = 7;
+   }
+
+   CHECK_EQUAL(0xFFFFFFFF, ScheduleTimeMatch_DueMaskSse2(times, SCHEDULETIMEMATCH_BLOCK_SIZE, 7));
+}
+
+TEST(ScheduleTimeMatch, Avx2KernelShouldMatchTheScalarKernelForRandomBlocks)
+{
+   if(ScheduleTimeMatch_Avx2Supported())
+   {
+      KernelShouldMatchTheScalarKernel(ScheduleTimeMatch_DueMaskAvx2);
+   }
+}
+
+#endif
+
+TEST(ScheduleTimeMatch, ShouldAssertWhenGivenMoreThanABlock)
+{
+   CHECK_ASSERTION_FAILED(ScheduleTimeMatch_DueMask(times, SCHEDULETIMEMATCH_BLOCK_SIZE + 1, 0));
+}
@@ -0,0 +1,239 @@
+/*!
+ * @file
+ * @brief Tests for sharded light scheduler implementation.
+ */
+
+extern "C"
+{
+#include "ShardedLightScheduler.h"
+}
+
+#include <pthread.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "DigitalOutputGroup_Fake.h"
+#include "DigitalOutputGroup_Mock.h"
+#include "TimeSource_Fake.h"
+#include "TimeSource_Mock.h"
+#include "uassert_test.h"
+
+enum
+{
+   ShardCount = 2,
+   SchedulesPerShard = 8
+};
+
+TEST_GROUP(ShardedLightScheduler)
+{
+   ShardedLightScheduler_t scheduler;
+   LightScheduler_t shards[ShardCount];
+   LightSchedulerStorage_t storage[ShardCount][LIGHTSCHEDULER_STORAGE_LENGTH(SchedulesPerShard)];
+
+   DigitalOutputGroup_Mock_t fakeDigitalOutputGroups[ShardCount];
+   TimeSource_Mock_t fakeTimeSource;
+
+   void setup()
+   {
+      TimeSource_Mock_Init(&fakeTimeSource);
+      ShardedLightScheduler_Init(&scheduler, (I_TimeSource_t *)&fakeTimeSource, shards, ShardCount);
+
+      for(uint8_t shard = 0; shard < ShardCount; shard++)
+      {
+         DigitalOutputGroup_Mock_Init(&fakeDigitalOutputGroups[shard]);
+         ShardedLightScheduler_InitShard(
+            &scheduler,
+            shard,
+            (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroups[shard],
+            storage[shard],
+            SchedulesPerShard);
+      }
+   }
+
+   void LightShouldBeTurnedOnByShard(LightSchedulerLightId_t which, uint8_t shard)
+   {
+      mock()
+          .expectOneCall("Write")
+          .onObject(&fakeDigitalOutputGroups[shard])
+          .withParameter("channel", which)
+          .withParameter("state", true);
+   }
+
+   void GivenTheTickHasBegunAtTime(TimeSourceTickCount_t time)
+   {
+      mock()
+          .expectOneCall("GetTicks")
+          .onObject(&fakeTimeSource)
+          .andReturnValue(time);
+      ShardedLightScheduler_BeginTick(&scheduler);
+   }
+
+   void WhenTheLightSchedulerIsRunAtTime(TimeSourceTickCount_t time)
+   {
+      mock()
+          .expectOneCall("GetTicks")
+          .onObject(&fakeTimeSource)
+          .andReturnValue(time);
+      ShardedLightScheduler_Run(&scheduler);
+   }
+};
+
+TEST(ShardedLightScheduler, ShouldAssertWhenThereAreNoShards)
+{
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_Init(&scheduler, (I_TimeSource_t *)&fakeTimeSource, shards, 0));
+}
+
+TEST(ShardedLightScheduler, ShouldDivideLightsAmongTheShardsByLightId)
+{
+   CHECK_EQUAL(0, ShardedLightScheduler_ShardForLight(&scheduler, 0));
+   CHECK_EQUAL(1, ShardedLightScheduler_ShardForLight(&scheduler, 1));
+   CHECK_EQUAL(0, ShardedLightScheduler_ShardForLight(&scheduler, 4));
+   POINTERS_EQUAL(&shards[1], ShardedLightScheduler_Shard(&scheduler, 7));
+}
+
+TEST(ShardedLightScheduler, ShouldAddEachScheduleToTheShardForItsLight)
+{
+   ShardedLightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   ShardedLightScheduler_AddSchedule(&scheduler, 3, true, 10);
+   ShardedLightScheduler_AddSchedule(&scheduler, 5, true, 10);
+
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&shards[0]));
+   CHECK_EQUAL(2, LightScheduler_ScheduleCount(&shards[1]));
+}
+
+TEST(ShardedLightScheduler, ShouldTurnOnEachLightThroughItsShardsOutputs)
+{
+   ShardedLightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   ShardedLightScheduler_AddSchedule(&scheduler, 3, true, 10);
+
+   LightShouldBeTurnedOnByShard(2, 0);
+   LightShouldBeTurnedOnByShard(3, 1);
+   WhenTheLightSchedulerIsRunAtTime(10);
+}
+
+TEST(ShardedLightScheduler, ShouldReadTheTimeSourceOncePerTickForEveryShard)
+{
+   ShardedLightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   ShardedLightScheduler_AddSchedule(&scheduler, 3, true, 10);
+   GivenTheTickHasBegunAtTime(10);
+
+   LightShouldBeTurnedOnByShard(3, 1);
+   ShardedLightScheduler_RunShard(&scheduler, 1);
+
+   LightShouldBeTurnedOnByShard(2, 0);
+   ShardedLightScheduler_RunShard(&scheduler, 0);
+}
+
+TEST(ShardedLightScheduler, ShouldAssertWhenRunningAShardThatDoesNotExist)
+{
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_RunShard(&scheduler, ShardCount));
+}
+
+TEST(ShardedLightScheduler, ShouldRemoveSchedulesFromTheShardForTheirLight)
+{
+   ShardedLightScheduler_AddSchedule(&scheduler, 2, true, 10);
+   ShardedLightScheduler_AddSchedule(&scheduler, 3, true, 10);
+   ShardedLightScheduler_AddSchedule(&scheduler, 3, true, 20);
+   ShardedLightScheduler_AddSchedule(&scheduler, 5, true, 10);
+
+   ShardedLightScheduler_RemoveSchedule(&scheduler, 2, true, 10);
+   CHECK_EQUAL(2, ShardedLightScheduler_RemoveAllForLight(&scheduler, 3));
+
+   CHECK_EQUAL(0, LightScheduler_ScheduleCount(&shards[0]));
+   CHECK_EQUAL(1, LightScheduler_ScheduleCount(&shards[1]));
+}
+
+enum
+{
+   StressShardCount = 4,
+   StressSchedulesPerShard = 64,
+   StressTicks = 200
+};
+
+typedef struct
+{
+   ShardedLightScheduler_t *scheduler;
+   uint8_t shard;
+   volatile bool *start;
+} StressRunner_t;
+
+static void *RunShard(void *context)
+{
+   StressRunner_t *runner = (StressRunner_t *)context;
+
+   while(!__atomic_load_n(runner->start, __ATOMIC_ACQUIRE))
+   {
+      sched_yield();
+   }
+
+   ShardedLightScheduler_RunShard(runner->scheduler, runner->shard);
+   return NULL;
+}
+
+// Runs every shard on its own thread for the same tick
+TEST_GROUP(ShardedLightSchedulerStress)
+{
+   ShardedLightScheduler_t scheduler;
+   LightScheduler_t shards[StressShardCount];
+   LightSchedulerStorage_t storage[StressShardCount][LIGHTSCHEDULER_STORAGE_LENGTH(StressSchedulesPerShard)];
+
+   TimeSource_Fake_t timeSource;
+   DigitalOutputGroup_Fake_t lights[StressShardCount];
+
+   void setup()
+   {
+      TimeSource_Fake_Init(&timeSource);
+      ShardedLightScheduler_Init(&scheduler, &timeSource.interface, shards, StressShardCount);
+
+      for(uint8_t shard = 0; shard < StressShardCount; shard++)
+      {
+         DigitalOutputGroup_Fake_Init(&lights[shard]);
+         ShardedLightScheduler_InitShard(
+            &scheduler,
+            shard,
+            &lights[shard].interface,
+            storage[shard],
+            StressSchedulesPerShard);
+      }
+
+      for(uint32_t i = 0; i < StressShardCount * StressSchedulesPerShard; i++)
+      {
+         ShardedLightScheduler_AddSchedule(&scheduler, (LightSchedulerLightId_t)(i % 16), true, 1 + (i % StressTicks));
+      }
+   }
+};
+
+TEST(ShardedLightSchedulerStress, ShouldRunEveryShardConcurrently)
+{
+   for(TimeSourceTickCount_t ticks = 1; ticks <= StressTicks; ticks++)
+   {
+      volatile bool start = false;
+      StressRunner_t runners[StressShardCount];
+      pthread_t threads[StressShardCount];
+
+      TimeSource_Fake_SetTicks(&timeSource, ticks);
+      ShardedLightScheduler_BeginTick(&scheduler);
+
+      for(uint8_t shard = 0; shard < StressShardCount; shard++)
+      {
+         runners[shard].scheduler = &scheduler;
+         runners[shard].shard = shard;
+         runners[shard].start = &start;
+         CHECK_EQUAL(0, pthread_create(&threads[shard], NULL, RunShard, &runners[shard]));
+      }
+
+      __atomic_store_n(&start, true, __ATOMIC_RELEASE);
+
+      for(uint8_t shard = 0; shard < StressShardCount; shard++)
+      {
+         pthread_join(threads[shard], NULL);
+      }
+   }
+
+   uint32_t writes = 0;
+   for(uint8_t shard = 0; shard < StressShardCount; shard++)
+   {
+      CHECK_EQUAL(StressSchedulesPerShard, DigitalOutputGroup_Fake_Writes(&lights[shard]));
+      writes += DigitalOutputGroup_Fake_Writes(&lights[shard]);
+   }
+   CHECK_EQUAL(StressShardCount * StressSchedulesPerShard, writes);
+}
@@ -0,0 +1,386 @@
+/*!
+ * @file
+ * @brief Tests for sorted schedule index implementation.
+ */
+
+extern "C"
+{
+#include "SortedScheduleIndex.h"
+}
+
+#include "CppUTest/TestHarness.h"
+#include "uassert_test.h"
+
+enum
+{
+   Capacity = 8
+};
+
+static ScheduleTicks_t TimeOfSlot(const void *context, ScheduleSlot_t slot)
+{
+   return ((const ScheduleTicks_t *)context)[slot];
+}
+
+TEST_GROUP(SortedScheduleIndex)
+{
+   SortedScheduleIndex_t index;
+   ScheduleTicks_t times[Capacity];
+   ScheduleSlot_t slots[Capacity];
+
+   void setup()
+   {
+      SortedScheduleIndex_Init(&index, times, slots, Capacity);
+   }
+
+   void GivenSlotIsInsertedAt(ScheduleSlot_t slot, ScheduleTicks_t time)
+   {
+      SortedScheduleIndex_Insert(&index, time, slot);
+   }
+
+   void TheSlotsInOrderShouldBe(const ScheduleSlot_t *expected, uint32_t count)
+   {
+      uint32_t found = 0;
+
+      for(uint32_t position = 0; position < index.count; position++)
+      {
+         if(index.slots[position] != SORTEDSCHEDULEINDEX_REMOVED_SLOT)
+         {
+            CHECK(found < count);
+            CHECK_EQUAL(expected[found], index.slots[position]);
+            found++;
+         }
+      }
+
+      CHECK_EQUAL(count, found);
+   }
+};
+
+TEST(SortedScheduleIndex, ShouldBeEmptyAfterInit)
+{
+   CHECK_EQUAL(0, index.count);
+   CHECK_EQUAL(0, SortedScheduleIndex_LowerBound(&index, 12));
+}
+
+TEST(SortedScheduleIndex, ShouldKeepEntriesInTimeOrder)
+{
+   GivenSlotIsInsertedAt(0, 30);
+   GivenSlotIsInsertedAt(1, 10);
+   GivenSlotIsInsertedAt(2, 20);
+
+   const ScheduleSlot_t expected[] = { 1, 2, 0 };
+   TheSlotsInOrderShouldBe(expected, 3);
+}
+
+TEST(SortedScheduleIndex, ShouldKeepEntriesWithTheSameTimeInInsertionOrder)
+{
+   GivenSlotIsInsertedAt(5, 10);
+   GivenSlotIsInsertedAt(3, 10);
+   GivenSlotIsInsertedAt(4, 5);
+   GivenSlotIsInsertedAt(1, 10);
+
+   const ScheduleSlot_t expected[] = { 4, 5, 3, 1 };
+   TheSlotsInOrderShouldBe(expected, 4);
+}
+
+TEST(SortedScheduleIndex, ShouldMergeManySlotsInsertedAtOnceIntoTheEntriesInTheIndex)
+{
+   const ScheduleTicks_t slotTimes[] = { 0, 0, 0, 5, 10, 10, 20, 30 };
+   const ScheduleSlot_t many[] = { 3, 4, 6, 7 };
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 25);
+   GivenSlotIsInsertedAt(2, 30);
+
+   SortedScheduleIndex_InsertMany(&index, many, 4, TimeOfSlot, slotTimes);
+
+   const ScheduleSlot_t expected[] = { 3, 0, 4, 6, 1, 2, 7 };
+   TheSlotsInOrderShouldBe(expected, 7);
+   CHECK_EQUAL(7, index.count);
+}
+
+TEST(SortedScheduleIndex, ShouldMakeRoomForManySlotsByCompactingRemovedEntries)
+{
+   const ScheduleTicks_t slotTimes[] = { 10, 20, 30, 40, 50, 60, 70, 80, 1, 2, 3 };
+   const ScheduleSlot_t many[] = { 8, 9, 10 };
+   for(ScheduleSlot_t slot = 0; slot < Capacity; slot++)
+   {
+      GivenSlotIsInsertedAt(slot, slotTimes[slot]);
+   }
+   SortedScheduleIndex_RemoveAt(&index, 1);
+   SortedScheduleIndex_RemoveAt(&index, 3);
+   SortedScheduleIndex_RemoveAt(&index, 5);
+
+   SortedScheduleIndex_InsertMany(&index, many, 3, TimeOfSlot, slotTimes);
+
+   const ScheduleSlot_t expected[] = { 8, 9, 10, 0, 2, 4, 6, 7 };
+   TheSlotsInOrderShouldBe(expected, 8);
+}
+
+TEST(SortedScheduleIndex, ShouldAssertWhenInsertingMoreSlotsThanFit)
+{
+   const ScheduleTicks_t slotTimes[Capacity + 1] = { 0 };
+   const ScheduleSlot_t many[Capacity + 1] = { 0 };
+
+   CHECK_ASSERTION_FAILED(SortedScheduleIndex_InsertMany(&index, many, Capacity + 1, TimeOfSlot, slotTimes));
+}
+
+TEST(SortedScheduleIndex, ShouldFindTheFirstEntryDueAtOrAfterATime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 20);
+   GivenSlotIsInsertedAt(3, 30);
+
+   CHECK_EQUAL(0, SortedScheduleIndex_LowerBound(&index, 5));
+   CHECK_EQUAL(1, SortedScheduleIndex_LowerBound(&index, 20));
+   CHECK_EQUAL(3, SortedScheduleIndex_LowerBound(&index, 21));
+   CHECK_EQUAL(4, SortedScheduleIndex_LowerBound(&index, 31));
+}
+
+TEST(SortedScheduleIndex, ShouldFindEntriesWhenTimeMovesBackwards)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 30);
+
+   CHECK_EQUAL(2, SortedScheduleIndex_LowerBound(&index, 30));
+   CHECK_EQUAL(0, SortedScheduleIndex_LowerBound(&index, 10));
+}
+
+TEST(SortedScheduleIndex, ShouldFindEntriesAfterWalkingPastManyEntries)
+{
+   for(ScheduleSlot_t slot = 0; slot < Capacity; slot++)
+   {
+      GivenSlotIsInsertedAt(slot, (ScheduleTicks_t)(slot * 2));
+   }
+
+   CHECK_EQUAL(0, SortedScheduleIndex_LowerBound(&index, 0));
+   CHECK_EQUAL(7, SortedScheduleIndex_LowerBound(&index, 13));
+   CHECK_EQUAL(7, SortedScheduleIndex_LowerBound(&index, 14));
+}
+
+TEST(SortedScheduleIndex, ShouldFindEntriesAfterTheCursorWasInvalidatedByInsertion)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   CHECK_EQUAL(2, SortedScheduleIndex_LowerBound(&index, 25));
+
+   GivenSlotIsInsertedAt(2, 22);
+
+   CHECK_EQUAL(2, SortedScheduleIndex_LowerBound(&index, 21));
+}
+
+TEST(SortedScheduleIndex, ShouldRemoveAnEntryAndKeepTheRestInOrder)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 30);
+
+   SortedScheduleIndex_RemoveAt(&index, 1);
+
+   const ScheduleSlot_t expected[] = { 0, 2 };
+   TheSlotsInOrderShouldBe(expected, 2);
+}
+
+TEST(SortedScheduleIndex, ShouldAssertWhenInsertingIntoAFullIndex)
+{
+   for(ScheduleSlot_t slot = 0; slot < Capacity; slot++)
+   {
+      GivenSlotIsInsertedAt(slot, 1);
+   }
+
+   CHECK_ASSERTION_FAILED(SortedScheduleIndex_Insert(&index, 1, Capacity));
+}
+
+TEST(SortedScheduleIndex, ShouldCountTheEntriesDueAtATime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 20);
+   GivenSlotIsInsertedAt(3, 20);
+   GivenSlotIsInsertedAt(4, 30);
+
+   CHECK_EQUAL(3, SortedScheduleIndex_CountDueAt(&index, 1, 20));
+   CHECK_EQUAL(1, SortedScheduleIndex_CountDueAt(&index, 4, 30));
+   CHECK_EQUAL(0, SortedScheduleIndex_CountDueAt(&index, 0, 20));
+   CHECK_EQUAL(0, SortedScheduleIndex_CountDueAt(&index, 5, 30));
+}
+
+TEST(SortedScheduleIndex, ShouldKeepThePositionsOfOtherEntriesWhenRemovingAtAPosition)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 30);
+
+   SortedScheduleIndex_RemoveAt(&index, 0);
+
+   CHECK_EQUAL(SORTEDSCHEDULEINDEX_REMOVED_SLOT, index.slots[0]);
+   CHECK_EQUAL(1, index.slots[1]);
+   CHECK_EQUAL(2, index.slots[2]);
+}
+
+TEST(SortedScheduleIndex, ShouldRemoveASlotAtItsTime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 20);
+   GivenSlotIsInsertedAt(3, 30);
+
+   CHECK_TRUE(SortedScheduleIndex_Remove(&index, 20, 2));
+
+   const ScheduleSlot_t expected[] = { 0, 1, 3 };
+   TheSlotsInOrderShouldBe(expected, 3);
+}
+
+TEST(SortedScheduleIndex, ShouldNotRemoveASlotThatIsNotAtTheGivenTime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+
+   CHECK_FALSE(SortedScheduleIndex_Remove(&index, 20, 0));
+   CHECK_FALSE(SortedScheduleIndex_Remove(&index, 25, 1));
+
+   const ScheduleSlot_t expected[] = { 0, 1 };
+   TheSlotsInOrderShouldBe(expected, 2);
+}
+
+TEST(SortedScheduleIndex, ShouldCompactRemovedEntriesOnceMostEntriesAreRemoved)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 30);
+
+   SortedScheduleIndex_Remove(&index, 10, 0);
+   CHECK_EQUAL(3, index.count);
+
+   SortedScheduleIndex_Remove(&index, 30, 2);
+   CHECK_EQUAL(1, index.count);
+   CHECK_EQUAL(0, index.removed);
+   CHECK_EQUAL(1, index.slots[0]);
+}
+
+TEST(SortedScheduleIndex, ShouldReuseRemovedEntriesWhenInsertingIntoAFullIndex)
+{
+   for(ScheduleSlot_t slot = 0; slot < Capacity; slot++)
+   {
+      GivenSlotIsInsertedAt(slot, (ScheduleTicks_t)slot);
+   }
+   SortedScheduleIndex_RemoveAt(&index, 3);
+
+   GivenSlotIsInsertedAt(3, 100);
+
+   const ScheduleSlot_t expected[] = { 0, 1, 2, 4, 5, 6, 7, 3 };
+   TheSlotsInOrderShouldBe(expected, Capacity);
+}
+
+TEST(SortedScheduleIndex, ShouldCollectTheSlotsDueInARangeInOrder)
+{
+   GivenSlotIsInsertedAt(0, 30);
+   GivenSlotIsInsertedAt(1, 10);
+   GivenSlotIsInsertedAt(2, 20);
+   GivenSlotIsInsertedAt(3, 10);
+   GivenSlotIsInsertedAt(4, 40);
+   SortedScheduleIndex_Remove(&index, 20, 2);
+
+   ScheduleSlot_t due[Capacity];
+   CHECK_EQUAL(3, SortedScheduleIndex_CollectDue(&index, 10, 30, due));
+   CHECK_EQUAL(1, due[0]);
+   CHECK_EQUAL(3, due[1]);
+   CHECK_EQUAL(0, due[2]);
+}
+
+TEST(SortedScheduleIndex, ShouldCollectTheSlotsDueAtOneTime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 20);
+
+   ScheduleSlot_t due[Capacity];
+   CHECK_EQUAL(2, SortedScheduleIndex_CollectDue(&index, 20, 20, due));
+   CHECK_EQUAL(1, due[0]);
+   CHECK_EQUAL(2, due[1]);
+   CHECK_EQUAL(0, SortedScheduleIndex_CollectDue(&index, 15, 15, due));
+}
+
+TEST(SortedScheduleIndex, ShouldCollectTheSlotsDueUpToTheLastTime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, SCHEDULETICKS_MAX);
+
+   ScheduleSlot_t due[Capacity];
+   CHECK_EQUAL(1, SortedScheduleIndex_CollectDue(&index, 11, SCHEDULETICKS_MAX, due));
+   CHECK_EQUAL(1, due[0]);
+}
+
+TEST(SortedScheduleIndex, ShouldBeUsableThroughTheScheduleIndexInterface)
+{
+   I_ScheduleIndex_t *interface = &index.interface;
+   ScheduleIndex_Insert(interface, 10, 0);
+   ScheduleIndex_Insert(interface, 10, 1);
+   CHECK_TRUE(ScheduleIndex_Remove(interface, 10, 0));
+
+   ScheduleSlot_t due[Capacity];
+   CHECK_EQUAL(1, ScheduleIndex_CollectDue(interface, 0, 20, due));
+   CHECK_EQUAL(1, due[0]);
+}
+
+TEST(SortedScheduleIndex, ShouldFindNothingDueWhenEmpty)
+{
+   ScheduleTicks_t time;
+   CHECK_FALSE(SortedScheduleIndex_NextDue(&index, 0, &time));
+}
+
+TEST(SortedScheduleIndex, ShouldFindTheNextTimeDueAtOrAfterATime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   GivenSlotIsInsertedAt(2, 30);
+   SortedScheduleIndex_RemoveAt(&index, 1);
+
+   ScheduleTicks_t time;
+   CHECK_TRUE(SortedScheduleIndex_NextDue(&index, 10, &time));
+   CHECK_EQUAL(10, time);
+   CHECK_TRUE(SortedScheduleIndex_NextDue(&index, 11, &time));
+   CHECK_EQUAL(30, time);
+}
+
+TEST(SortedScheduleIndex, ShouldWrapAroundToTheEarliestTimeWhenNothingIsDueAfterATime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+   SortedScheduleIndex_RemoveAt(&index, 0);
+
+   ScheduleTicks_t time;
+   CHECK_TRUE(SortedScheduleIndex_NextDue(&index, 21, &time));
+   CHECK_EQUAL(20, time);
+}
+
+TEST(SortedScheduleIndex, ShouldCompactALongRunOfRemovedEntriesInTheWayOfTheNextTimeDue)
+{
+   enum
+   {
+      LargeCapacity = 32,
+      Removed = 12
+   };
+   SortedScheduleIndex_t large;
+   ScheduleTicks_t largeTimes[LargeCapacity];
+   ScheduleSlot_t largeSlots[LargeCapacity];
+   SortedScheduleIndex_Init(&large, largeTimes, largeSlots, LargeCapacity);
+
+   for(ScheduleSlot_t slot = 0; slot < LargeCapacity; slot++)
+   {
+      SortedScheduleIndex_Insert(&large, (ScheduleTicks_t)(10 + slot), slot);
+   }
+   for(uint32_t position = 0; position < Removed; position++)
+   {
+      SortedScheduleIndex_RemoveAt(&large, position);
+   }
+
+   ScheduleTicks_t time;
+   CHECK_TRUE(SortedScheduleIndex_NextDue(&large, 5, &time));
+   CHECK_EQUAL(10 + Removed, time);
+   CHECK_EQUAL(0, large.removed);
+   CHECK_EQUAL(LargeCapacity - Removed, large.count);
+
+   CHECK_TRUE(SortedScheduleIndex_NextDue(&large, 60, &time));
+   CHECK_EQUAL(10 + Removed, time);
+}
@@ -0,0 +1,211 @@
+/*!
+ * @file
+ * @brief Tests for timing wheel schedule index implementation.
+ */
+
+extern "C"
+{
+#include "TimingWheelScheduleIndex.h"
+}
+
+#include "CppUTest/TestHarness.h"
+#include "uassert_test.h"
+
+enum
+{
+   Capacity = 8,
+   Buckets = 4
+};
+
+TEST_GROUP(TimingWheelScheduleIndex)
+{
+   TimingWheelScheduleIndex_t wheel;
+   ScheduleTicks_t times[Capacity];
+   ScheduleSlot_t next[Capacity];
+   ScheduleSlot_t previous[Capacity];
+   ScheduleSlot_t heads[Buckets];
+   uint32_t occupied[TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(Buckets)];
+   ScheduleSlot_t due[Capacity];
+
+   void setup()
+   {
+      TimingWheelScheduleIndex_Init(&wheel, times, next, previous, heads, occupied, Capacity, Buckets);
+   }
+
+   void GivenSlotIsInsertedAt(ScheduleSlot_t slot, ScheduleTicks_t time)
+   {
+      TimingWheelScheduleIndex_Insert(&wheel, time, slot);
+   }
+
+   void TheSlotsDueShouldBe(ScheduleTicks_t first, ScheduleTicks_t last, const ScheduleSlot_t *expected, uint32_t count)
+   {
+      CHECK_EQUAL(count, TimingWheelScheduleIndex_CollectDue(&wheel, first, last, due));
+
+      for(uint32_t i = 0; i < count; i++)
+      {
+         CHECK_EQUAL(expected[i], due[i]);
+      }
+   }
+};
+
+TEST(TimingWheelScheduleIndex, ShouldHaveNothingDueAfterInit)
+{
+   TheSlotsDueShouldBe(0, SCHEDULETICKS_MAX, NULL, 0);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldCollectOnlyTheSlotsDueAtATimeFromASharedBucket)
+{
+   GivenSlotIsInsertedAt(0, 1);
+   GivenSlotIsInsertedAt(1, 1 + Buckets);
+   GivenSlotIsInsertedAt(2, 1 + 2 * Buckets);
+
+   const ScheduleSlot_t expected[] = { 1 };
+   TheSlotsDueShouldBe(1 + Buckets, 1 + Buckets, expected, 1);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldCollectSlotsInTimeOrderAndThenInsertionOrder)
+{
+   GivenSlotIsInsertedAt(0, 30);
+   GivenSlotIsInsertedAt(1, 10);
+   GivenSlotIsInsertedAt(2, 20);
+   GivenSlotIsInsertedAt(3, 10);
+   GivenSlotIsInsertedAt(4, 31);
+
+   const ScheduleSlot_t expected[] = { 1, 3, 2, 0 };
+   TheSlotsDueShouldBe(10, 30, expected, 4);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldCollectSlotsOverARangeLongerThanTheWheel)
+{
+   GivenSlotIsInsertedAt(0, 100);
+   GivenSlotIsInsertedAt(1, 3);
+   GivenSlotIsInsertedAt(2, 50);
+
+   const ScheduleSlot_t expected[] = { 1, 2, 0 };
+   TheSlotsDueShouldBe(0, 100, expected, 3);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldCollectSlotsDueAtTheLastTime)
+{
+   GivenSlotIsInsertedAt(0, SCHEDULETICKS_MAX);
+   GivenSlotIsInsertedAt(1, SCHEDULETICKS_MAX - 1);
+
+   const ScheduleSlot_t expected[] = { 1, 0 };
+   TheSlotsDueShouldBe(SCHEDULETICKS_MAX - 2, SCHEDULETICKS_MAX, expected, 2);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldRemoveSlotsFromAnywhereInABucket)
+{
+   for(ScheduleSlot_t slot = 0; slot < 4; slot++)
+   {
+      GivenSlotIsInsertedAt(slot, 2);
+   }
+
+   CHECK_TRUE(TimingWheelScheduleIndex_Remove(&wheel, 2, 3));
+   CHECK_TRUE(TimingWheelScheduleIndex_Remove(&wheel, 2, 0));
+   CHECK_TRUE(TimingWheelScheduleIndex_Remove(&wheel, 2, 2));
+
+   GivenSlotIsInsertedAt(5, 2);
+   const ScheduleSlot_t expected[] = { 1, 5 };
+   TheSlotsDueShouldBe(2, 2, expected, 2);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldHaveNothingDueOnceEverySlotIsRemoved)
+{
+   GivenSlotIsInsertedAt(0, 2);
+   GivenSlotIsInsertedAt(1, 7);
+
+   CHECK_TRUE(TimingWheelScheduleIndex_Remove(&wheel, 2, 0));
+   CHECK_TRUE(TimingWheelScheduleIndex_Remove(&wheel, 7, 1));
+
+   TheSlotsDueShouldBe(0, SCHEDULETICKS_MAX, NULL, 0);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldNotRemoveASlotThatIsNotAtTheGivenTime)
+{
+   GivenSlotIsInsertedAt(0, 2);
+
+   CHECK_FALSE(TimingWheelScheduleIndex_Remove(&wheel, 2 + Buckets, 0));
+   CHECK_FALSE(TimingWheelScheduleIndex_Remove(&wheel, 2, 1));
+   CHECK_FALSE(TimingWheelScheduleIndex_Remove(&wheel, 2, Capacity));
+   CHECK_TRUE(TimingWheelScheduleIndex_Remove(&wheel, 2, 0));
+   CHECK_FALSE(TimingWheelScheduleIndex_Remove(&wheel, 2, 0));
+}
+
+TEST(TimingWheelScheduleIndex, ShouldFindOccupiedBucketsAcrossBitmapWords)
+{
+   enum { ManyBuckets = 128 };
+   ScheduleSlot_t manyHeads[ManyBuckets];
+   uint32_t manyOccupied[TIMINGWHEELSCHEDULEINDEX_OCCUPIED_WORDS(ManyBuckets)];
+   TimingWheelScheduleIndex_Init(&wheel, times, next, previous, manyHeads, manyOccupied, Capacity, ManyBuckets);
+
+   GivenSlotIsInsertedAt(0, 100);
+   GivenSlotIsInsertedAt(1, 5);
+   GivenSlotIsInsertedAt(2, 200);
+
+   const ScheduleSlot_t expected[] = { 0, 2 };
+   TheSlotsDueShouldBe(90, 210, expected, 2);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldBeUsableThroughTheScheduleIndexInterface)
+{
+   I_ScheduleIndex_t *interface = &wheel.interface;
+   ScheduleIndex_Insert(interface, 10, 0);
+   ScheduleIndex_Insert(interface, 10, 1);
+   CHECK_TRUE(ScheduleIndex_Remove(interface, 10, 0));
+
+   CHECK_EQUAL(1, ScheduleIndex_CollectDue(interface, 0, 20, due));
+   CHECK_EQUAL(1, due[0]);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldAssertWhenTheNumberOfBucketsIsNotAPowerOfTwo)
+{
+   CHECK_ASSERTION_FAILED(TimingWheelScheduleIndex_Init(&wheel, times, next, previous, heads, occupied, Capacity, 3));
+}
+
+TEST(TimingWheelScheduleIndex, ShouldAssertWhenInsertingASlotThatIsAlreadyInTheWheel)
+{
+   GivenSlotIsInsertedAt(0, 2);
+
+   CHECK_ASSERTION_FAILED(TimingWheelScheduleIndex_Insert(&wheel, 3, 0));
+}
+
+TEST(TimingWheelScheduleIndex, ShouldFindNothingDueWhenEmpty)
+{
+   ScheduleTicks_t time;
+   CHECK_FALSE(TimingWheelScheduleIndex_NextDue(&wheel, 0, &time));
+}
+
+TEST(TimingWheelScheduleIndex, ShouldFindTheNextTimeDueWithinATurnOfTheWheel)
+{
+   GivenSlotIsInsertedAt(0, 2 + Buckets);
+   GivenSlotIsInsertedAt(1, 3);
+   GivenSlotIsInsertedAt(2, 4);
+
+   ScheduleTicks_t time;
+   CHECK_TRUE(TimingWheelScheduleIndex_NextDue(&wheel, 3, &time));
+   CHECK_EQUAL(3, time);
+   CHECK_TRUE(TimingWheelScheduleIndex_NextDue(&wheel, 4 + 1, &time));
+   CHECK_EQUAL(2 + Buckets, time);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldFindTheNextTimeDueMoreThanATurnOfTheWheelAway)
+{
+   GivenSlotIsInsertedAt(0, 100);
+   GivenSlotIsInsertedAt(1, 41);
+   GivenSlotIsInsertedAt(2, 2);
+
+   ScheduleTicks_t time;
+   CHECK_TRUE(TimingWheelScheduleIndex_NextDue(&wheel, 10, &time));
+   CHECK_EQUAL(41, time);
+}
+
+TEST(TimingWheelScheduleIndex, ShouldWrapAroundToTheEarliestTimeWhenNothingIsDueAfterATime)
+{
+   GivenSlotIsInsertedAt(0, 10);
+   GivenSlotIsInsertedAt(1, 20);
+
+   ScheduleTicks_t time;
+   CHECK_TRUE(TimingWheelScheduleIndex_NextDue(&wheel, 21, &time));
+   CHECK_EQUAL(10, time);
+}